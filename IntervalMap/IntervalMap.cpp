@@ -1,171 +1,89 @@
+#include "IntervalMap.h"
+
 #include <assert.h>
-#include <map>
-#include <limits>
-#include <random>
-#include <memory>
-#include <iterator>
 #include <iostream>
+#include <string>
+#include <thread>
+
+// Verify that two storages of interval_map boundaries, e.g. a std::map and a B+-tree, hold exactly the same boundaries.
+template<class Expected, class Actual>
+void CheckSameBoundaries( Expected const& expected, Actual const& actual ) {
+	assert(expected.size() == actual.size());
+	auto actual_it = std::begin(actual);
+	for(const auto& boundary : expected) {
+		assert(boundary.first == actual_it->first && boundary.second == actual_it->second);
+		++actual_it;
+	}
+	assert(actual_it == std::end(actual));
+}
 
+#if defined(INTERVAL_MAP_COUNTERS)
+// Smallest number of bits b with 2^b >= n.
+std::size_t ceil_log2( std::size_t n ) {
+	std::size_t bits = 0;
+	while((std::size_t(1) << bits) < n)
+		++bits;
+	return bits;
+}
 
-// interval_map<K,V> is a data structure that efficiently associates intervals of keys of type K with values of type V. 
-// Your task is to implement the assign member function of this data structure, which is outlined below. 
-
-// interval_map<K, V> is implemented on top of std::map. In case you are not entirely sure which functions std::map provides,
-// what they do and which guarantees they provide, we have attached an excerpt of the C++1x draft standard at the end of this
-// file for your convenience. 
-
-// Each key-value-pair (k,v) in the m_map member means that the value v is associated to the interval from k (including) to
-// the next key (excluding) in m_map.
-// Example: the std::map (0,'A'), (3,'B'), (5,'A') represents the mapping
-// 0 -> 'A'
-// 1 -> 'A'
-// 2 -> 'A'
-// 3 -> 'B'
-// 4 -> 'B'
-// 5 -> 'A' 
-// 6 -> 'A'
-// 7 -> 'A'
-// ... all the way to numeric_limits<key>::max()
-
-// The representation in m_map must be canonical, that is, consecutive map entries must not have the same value: 
-// ..., (0,'A'), (3,'A'), ... is not allowed.
-// Initially, the whole range of K is associated with a given initial value, passed to the constructor.
-
-// Key type K
-// - besides being copyable and assignable, is less-than comparable via operator< ;
-// - is bounded below, with the lowest value being std::numeric_limits<K>::min();
-// - does not implement any other operations, in particular no equality comparison or arithmetic operators.
-
-// Value type V
-// - besides being copyable and assignable, is equality-comparable via operator== ;
-// - does not implement any other operations.
-
-template<class K, class V>
-class interval_map {
-	friend void IntervalMapTest();
-	
-private:	
-	std::map<K,V> m_map;
-
-public:
-	// constructor associates whole range of K with val by inserting (K_min, val) into the map
-	interval_map( V const& val) {
-		m_map.insert(m_map.begin(),std::make_pair(std::numeric_limits<K>::min(),val));
-	};
-
-	// Assign value val to interval [keyBegin, keyEnd). 
-	// Overwrite previous values in this interval. Do not change values outside this interval.
-	// Conforming to the C++ Standard Library conventions, the interval includes keyBegin, but excludes keyEnd.
-	// If !( keyBegin < keyEnd ), this designates an empty interval, and assign must do nothing.
-	void assign( K const& keyBegin, K const& keyEnd, const V& val ) {
-		// TODO:
-		// Implement this function.
-		// Your implementation is graded by these criteria in this order:
-		// - correctness (of course): In particular, pay attention to the validity of iterators. It is illegal to dereference
-		//   end iterators. Consider using a checking STL implementation such as the one shipped with Visual C++.
-		// - simplicity: simple code is easy to understand and maintain, which is important in large projects. 
-		//   To write a simple solution, you need to exploit the structure of the problem.
-		//   Use functions of std::map wherever you can.
-		// - running time: Imagine your implementation is part of a library, so it should be big-O optimal.
-		//   In addition, 
-		//   * do not make big-O more operations on K and V than necessary, because you 
-		//     do not know how fast operations on K/V are; remember that constructions, destructions and assignments 
-		//     are operations as well.
-		//   * do not make more than two operations of amortized O(log N), in contrast to O(1), running time, where N is the number of elements in m_map.
-		//     Any operation that needs to find a position in the map "from scratch", without being given a nearby position, is such an operation.
-		//   Otherwise favor simplicity over minor speed improvements.
-		// - time to turn in the solution: you should not take longer than a day, and you may be faster.
-		//   But don't rush, I would not give you this assignment if it were trivial.
-		//
-		// You must develop the solution yourself. You may not let others help you or search for existing solutions. Of course
-		// you may use any documentation of the C++ language or the C++ Standard Library.
-		// Do not give your solution to others or make it public. It will entice others into
-		// sending in plagiarized solutions.
-
-
-		// Assign only if the interval boundaries are valid.
-		if(keyBegin < keyEnd) {
-			// Find map item with key greater or equal to the new interval's upper boundary.
-			// Complexity: logarithmic
-			auto end_next_it = m_map.lower_bound(keyEnd);
-			auto next_interval_it = end_next_it;
-
-			// If found item's key is equal to the new interval's upper boundary nothing has to be done as these intervals are contiguous,
-			// otherwise create a new map item with a key equal to the new interval's upper boundary and value of the previous map item.
-			// This way values outside of the new interval's upper boundary will not be changed.
-			// In this if statement the iterator can be safely dereferenced, because if the second condition is reached that means
-			// the first condition was not satisfied, thus the iterator does not point to the after-the-last item in the map.
-			if(end_next_it == std::end(m_map) || keyEnd < end_next_it->first) {
-				auto end_previous_it = end_next_it;
-				--end_previous_it;
-				// New map item will lay between end_previous and end_next items,
-				// its value will be the one of the previous item.
-				// Save the iterator to the new item for further use in case a range of items has to be erased.
-				// Knowing that the new item is directly preceding the next item, iterator to the next item can be provided as a parameter to insert(), thus:
-				// Complexity: amortized constant
-				next_interval_it = m_map.insert(end_next_it,std::make_pair(keyEnd,end_previous_it->second));
-			}
-
-			// Insert a map item reflecting the new interval's lower boundary.
-			// Complexity: logarithmic
-			auto ins_begin_pair = m_map.insert(std::make_pair(keyBegin,val));
-
-			// If the second parameter of the result pair is true, a new map item has been created.
-			bool begin_inserted = ins_begin_pair.second;
-			bool re_insert_begin = false; // Flag used later.
-
-			// To overwrite previous values in this interval, all map items falling into it have to be erased.
-			// Special care has to be taken to assure that the map stays canonical.
-			// Let us temporarily assign the first element to be erased to the newly inserted map item reflecting
-			// the beginning of the interval (or already existing item with the same key).
-			auto erase_begin_it = ins_begin_pair.first;
-
-			// Now the value of the new interval has to be compared to the value of the preceding interval.
-			// If they are equal there lower boundary of the new interval should not be stored in the map.
-			if(begin_inserted) {
-				// Keep the lower boundary of the new interval in the map only if it is the first element in the map
-				// or if the value of the preceding interval is different.
-				// In this if statement the second condition safely dereferences a valid iterator as it is evaluated
-				// only if the first condition is false.
-				if(erase_begin_it == std::begin(m_map) || std::prev(erase_begin_it)->second != val)
-					++erase_begin_it;
-			}
-			else {
-				// If a map item reflecting the lower boundary of the new interval has not been created due to existence
-				// of another item with the same key, this other item has to be erased and the lower boundary reinserted.
-				re_insert_begin = true;
-				// In case the previous interval has the same value, the lower boundary of the new interval should not be stored in the map.
-				if(erase_begin_it != std::begin(m_map) && std::prev(erase_begin_it)->second == val)
-					re_insert_begin = false;
-			}
-
-			// Assign the last element to be erased to the lower boundary of the next interval.
-			auto erase_end_it = next_interval_it;
-
-			// If the value of the next interval is the same as the new interval's value, the lower boundary
-			// of the next interval should be erased from the map.
-			if(erase_end_it->second == val) {
-				++erase_end_it;
-			}
-
-			// Erase the unnecessary items from the map.
-			// Complexity: amortized O(N) where N is the number of items erased
-			m_map.erase(erase_begin_it,erase_end_it);
-
-			// If the lower boundary has to be reinserted it will directly precede the first unerased item (indicated by
-			// the erase_end iterator which stays valid after calling the erase() method).
-			// Complexity: amortized constant
-			if(re_insert_begin) {
-				m_map.insert(erase_end_it,std::make_pair(keyBegin,val));
-			}
-		}
+// Assign val to [keyBegin, keyEnd) and look up keyBegin in an interval_map of counted keys and values, verifying that
+// neither call exceeds its budget of operations:
+// - assign searches the map from scratch once, creates at most two boundaries, by insertion or by moving an overwritten
+//   one, and calls erase at most once. It copies at most two keys and compares values at most twice. It copies at most
+//   two values, or one if val is moved in. It compares keys at most 2 log2(N+1) times for the search (the height of a
+//   red-black tree, and more than a B+-tree with 64 slots needs), once for every boundary it erases, three times for
+//   every boundary it creates (the hint is checked against the keys around it, and by a B+-tree against a separator),
+//   plus five times.
+// - operator[] searches once, compares keys as many times as the search in assign may, and copies nothing.
+// If resource is given, the map uses map_storage, which allocates one node per insertion and reuses the node of a
+// boundary moved to another key. Neither keys nor values are moved, other than val. Before C++17 a moved boundary
+// gets a new node, into which its value is moved. A B+-tree moves entries within its nodes and copies keys into its
+// inner nodes as separators, so neither moves nor key copies are budgeted for it.
+template<class Map, class V>
+void CheckOperationBudget( Map& im, int keyBegin, int keyEnd, V const& val, bool move_val, counting_resource const* resource ) {
+	typedef counted<int> key_type;
+	typedef counted<V> value_type;
+	key_type const begin(keyBegin), end(keyEnd);
+	value_type value(val);
+
+	std::size_t const size_before = im.size();
+	std::size_t const allocations_before = resource ? resource->allocations() : 0;
+	im.reset_counters();
+	key_type::counts() = operation_counts();
+	value_type::counts() = operation_counts();
+	if(move_val)
+		im.assign(begin, end, std::move(value));
+	else
+		im.assign(begin, end, value);
+
+	interval_map_counters const counters = im.counters();
+	std::size_t const created = counters.insertions + counters.key_replacements;
+	std::size_t const erased = size_before + counters.insertions - im.size();
+	assert(counters.searches == (keyBegin < keyEnd ? 1u : 0u) && counters.erased_ranges <= 1 && created <= 2);
+	assert(value_type::counts().copies <= (move_val ? 1u : 2u) && value_type::counts().comparisons <= 2);
+	assert(key_type::counts().comparisons <= 2 * ceil_log2(size_before + 1) + erased + 3 * created + 5);
+	if(resource) {
+		assert(key_type::counts().copies <= 2 && key_type::counts().moves == 0);
+#if defined(__cpp_lib_node_extract)
+		assert(value_type::counts().moves <= (move_val ? 1u : 0u));
+		assert(resource->allocations() - allocations_before == counters.insertions);
+#else
+		assert(value_type::counts().moves <= (move_val ? 1u : 0u) + 2 * counters.key_replacements);
+		assert(resource->allocations() - allocations_before == created);
+#endif
 	}
 
-	// look-up of the value associated with key
-	V const& operator[]( K const& key ) const {
-		return ( --m_map.upper_bound(key) )->second;
-	}
-};
+	im.reset_counters();
+	key_type::counts() = operation_counts();
+	value_type::counts() = operation_counts();
+	value_type const& found = im[begin];
+	assert(im.counters().searches == 1 && im.counters().insertions == 0 && im.counters().erased_ranges == 0);
+	assert(key_type::counts().comparisons <= 2 * ceil_log2(im.size() + 1));
+	assert(key_type::counts().copies == 0 && key_type::counts().moves == 0);
+	assert(value_type::counts().copies == 0 && value_type::counts().moves == 0);
+	assert(!(keyBegin < keyEnd) || found.value() == val);
+}
+#endif
 
 // Provide a function IntervalMapTest() here that tests the functionality of the interval_map,
 // for example using a map of unsigned int intervals to char.
@@ -296,138 +214,711 @@ void IntervalMapTest() {
 		}
 	}
 
-	std::cout << "Test has completed successfully!" << std::endl;
-}
 
-int main(int argc, char* argv[]) {
-	IntervalMapTest();
-	return 0;
-}
 
-/*
-The following paragraphs from the final draft of the C++1x ISO standard describe the available 
-operations on a std::map container, their effects and their complexity.
+	// This randomised test applies the same intervals to an interval_map stored in a std::map and to one stored in a B+-tree,
+	// and verifies after every step that both hold exactly the same boundaries. Tiny nodes are used, so that even a few hundred
+	// boundaries make the tree several levels high and every assign splits, merges or rebalances nodes.
+	// The dense key range makes contiguous and coinciding boundaries frequent.
+	std::uniform_int_distribution<> dis_dense(0, 500);
+	interval_map<int,char> im_map(ch_init);
+	interval_map<int,char,btree_storage<4,4>> im_btree(ch_init);
+	for(std::size_t i=0; i < 10 * max_test_steps; i++) {
+		char val = dis_char(gen);
+		int min = dis_dense(gen);
+		int max = dis_dense(gen);
+		// Wide intervals erase most of the map, keep them rare so that the map does not stay small.
+		if(i % 4 != 0 && max - min > 50)
+			max = min + 50;
+
+		im_map.assign(min,max,val);
+		im_btree.assign(min,max,val);
+
+		CheckSameBoundaries(im_map.m_map, im_btree.m_map);
+	}
+	for(int key = -10; key < 510; key++) {
+		assert(im_map[key] == im_btree[key]);
+	}
+
+	// This randomised test applies the same insertions and range erasures to a B+-tree and to a std::map whose values own
+	// heap memory, so that moving an entry onto itself does not go unnoticed, as it would for values of trivial types.
+	// The same goes for interval_maps, where a new upper boundary gets a copy of a value stored in the tree.
+	{
+		std::map<int,std::string> map_strings;
+		btree_map<int,std::string,4,4> btree_strings;
+		for(std::size_t i=0; i < 10 * max_test_steps; i++) {
+			int key = dis_dense(gen);
+			if(i % 3 != 0) {
+				std::string val(30, dis_char(gen));
+				map_strings.insert(std::make_pair(key, val));
+				btree_strings.insert(std::make_pair(key, val));
+			}
+			else {
+				int end = std::min(key + dis_dense(gen) / 10, 501);
+				map_strings.erase(map_strings.lower_bound(key), map_strings.lower_bound(end));
+				btree_strings.erase(btree_strings.lower_bound(key), btree_strings.lower_bound(end));
+			}
+			CheckSameBoundaries(map_strings, btree_strings);
+		}
+
+		interval_map<int,std::string> im_strings(std::string(30, 'A'));
+		interval_map<int,std::string,btree_storage<4,4>> im_strings_btree(std::string(30, 'A'));
+		for(std::size_t i=0; i < 10 * max_test_steps; i++) {
+			int min = dis_dense(gen);
+			int max = std::min(dis_dense(gen), min + 50);
+			std::string val(30, dis_char(gen));
+			im_strings.assign(min, max, val);
+			im_strings_btree.assign(min, max, val);
+			CheckSameBoundaries(im_strings.m_map, im_strings_btree.m_map);
+		}
+		for(int key = -1; key <= 501; key++) {
+			assert(im_strings[key] == im_strings_btree[key]);
+		}
+	}
+
+
+
+	// This randomised test verifies that assign_sorted() gives the same boundaries as calling assign() for each interval.
+	// Runs of sorted, non-overlapping intervals (including empty and contiguous ones) are applied on top of the maps from
+	// the previous test, followed by a run in random order.
+	std::uniform_int_distribution<> dis_gap(0, 3);
+	for(std::size_t run=0; run < 20; run++) {
+		std::vector<interval<int,char>> intervals;
+		int key = dis_gap(gen) - 5;
+		while(key < 510) {
+			int begin = key;
+			int end = key + dis_gap(gen) * dis_gap(gen) - 1;
+			intervals.push_back(interval<int,char>{begin, end, dis_char(gen)});
+			key = std::max(begin, end) + dis_gap(gen);
+		}
+		if(run == 19)
+			std::shuffle(intervals.begin(), intervals.end(), gen);
+
+		interval_map<int,char> im_expected = im_map;
+		for(const auto& item : intervals) {
+			im_expected.assign(item.begin, item.end, item.value);
+		}
+		im_map.assign_sorted(intervals.begin(), intervals.end());
+		im_btree.assign_sorted(intervals.begin(), intervals.end());
+
+		assert(im_expected.m_map == im_map.m_map);
+		CheckSameBoundaries(im_expected.m_map, im_btree.m_map);
+	}
+
+
+
+	// This randomised test verifies that the batch lookup() resolves every key to the same value as operator[],
+	// for sorted keys (with repetitions and gaps) as well as for keys in random order.
+	std::vector<int> keys;
+	for(std::size_t i=0; i < 2000; i++) {
+		keys.push_back(dis_dense(gen) - 5);
+	}
+	for(std::size_t run=0; run < 2; run++) {
+		if(run == 1)
+			std::sort(keys.begin(), keys.end());
+
+		std::vector<char const*> map_values(keys.size());
+		std::vector<char const*> btree_values(keys.size());
+		assert(im_map.lookup(keys.begin(), keys.end(), map_values.begin()) == map_values.end());
+		assert(im_btree.lookup(keys.begin(), keys.end(), btree_values.begin()) == btree_values.end());
+		for(std::size_t i=0; i < keys.size(); i++) {
+			assert(map_values[i] == &im_map[keys[i]]);
+			assert(btree_values[i] == &im_btree[keys[i]]);
+		}
+	}
+
+
+
+	// This test verifies that a frozen_interval_map answers every look-up the same way as the interval_map it was made of.
+	// Maps of every size up to a few dozen boundaries are frozen, so that trees of every shape are covered.
+	interval_map<int,char> im_growing(ch_init);
+	for(std::size_t i=0; i < 40; i++) {
+		im_growing.assign(static_cast<int>(10 * i), static_cast<int>(10 * i + 5), static_cast<char>('a' + i % 2));
+		frozen_interval_map<int,char> frozen(im_growing);
+		assert(frozen.size() == im_growing.m_map.size());
+		for(int key = -10; key < 420; key++) {
+			assert(frozen[key] == im_growing[key]);
+		}
+	}
+	frozen_interval_map<int,char> frozen_growing(im_growing);
+	assert(frozen_growing[std::numeric_limits<int>::min()] == ch_init);
+	assert(frozen_growing[std::numeric_limits<int>::max()] == ch_init);
+
+	frozen_interval_map<int,char> frozen_btree(im_btree);
+	for(int key = -10; key < 510; key++) {
+		assert(frozen_btree[key] == im_btree[key]);
+	}
+
+	// bool values are returned by reference like any other, and stay valid as long as the frozen map.
+	interval_map<int,bool> im_flags(false);
+	im_flags.assign(5, 10, true);
+	frozen_interval_map<int,bool> frozen_flags(im_flags);
+	bool const& flag = frozen_flags[5];
+	assert(flag && !frozen_flags[4] && frozen_flags[9] && !frozen_flags[10] && &frozen_flags[7] == &flag);
+
+
+
+	// These tests verify the versions of a concurrent_interval_map. The boundaries of a version, listed by an in-order
+	// traversal of its tree, must be exactly the boundaries an interval_map has after the same assignments.
+	typedef concurrent_interval_map<int,int> concurrent_map;
+	auto boundaries_of = [](concurrent_map::snapshot const& snap) {
+		std::vector<std::pair<int,int>> boundaries;
+		std::vector<concurrent_map::node const*> stack;
+		for(auto n = snap.m_root.get(); n || !stack.empty(); ) {
+			if(n) {
+				stack.push_back(n);
+				n = n->left.get();
+			}
+			else {
+				n = stack.back();
+				stack.pop_back();
+				boundaries.push_back(std::make_pair(n->key, n->value));
+				n = n->right.get();
+			}
+		}
+		return boundaries;
+	};
+
+	std::vector<interval<int,int>> assignments;
+	for(std::size_t i=0; i < 2 * max_test_steps; i++) {
+		int begin = dis_dense(gen);
+		assignments.push_back(interval<int,int>{begin, begin + dis_dense(gen) / 10, static_cast<int>(i % 7)});
+	}
+	assignments.push_back(interval<int,int>{std::numeric_limits<int>::min(), 0, 0});
+
+	// Single thread: every version matches the interval_map, and snapshots taken earlier are not affected by later assignments.
+	// A reader sees every assignment, and keeps its snapshot as long as there is none.
+	concurrent_map cm(-1);
+	concurrent_map::reader cm_reader = cm.get_reader();
+	interval_map<int,int> im_reference(-1);
+	std::vector<std::pair<concurrent_map::snapshot, std::vector<std::pair<int,int>>>> versions;
+	for(const auto& item : assignments) {
+		cm.assign(item.begin, item.end, item.value);
+		im_reference.assign(item.begin, item.end, item.value);
+		assert(cm_reader[item.begin] == im_reference[item.begin] && cm_reader[item.end] == im_reference[item.end]);
+		std::vector<std::pair<int,int>> expected(std::begin(im_reference.m_map), std::end(im_reference.m_map));
+		assert(boundaries_of(cm.get_snapshot()) == expected);
+		if(versions.size() < 20)
+			versions.push_back(std::make_pair(cm.get_snapshot(), expected));
+	}
+	for(const auto& version : versions) {
+		assert(boundaries_of(version.first) == version.second);
+	}
+	auto const reader_root = cm_reader.m_snapshot.m_root.get();
+	long const reader_uses = cm_reader.m_snapshot.m_root.use_count();
+	for(int key = -10; key < 510; key++) {
+		assert(cm[key] == im_reference[key] && cm_reader[key] == im_reference[key]);
+	}
+	assert(cm_reader.m_snapshot.m_root.get() == reader_root && cm_reader.m_snapshot.m_root.use_count() == reader_uses);
+
+	// Multiple threads: a writer assigns the value i to the i-th interval, while readers take snapshots. The latest
+	// assignment is never overwritten yet, so the highest value in a snapshot tells how many assignments it contains.
+	// Each recorded snapshot has to match the interval_map built by replaying that many assignments. The second reader
+	// records the snapshots of a reader.
+	concurrent_map cm_shared(-1);
+	std::atomic<bool> writer_done(false);
+	std::vector<std::vector<concurrent_map::snapshot>> recorded(2);
+	std::thread writer([&]() {
+		for(std::size_t i=0; i < assignments.size(); i++) {
+			cm_shared.assign(assignments[i].begin, assignments[i].end, static_cast<int>(i));
+		}
+		writer_done = true;
+	});
+	std::vector<std::thread> readers;
+	for(std::size_t r=0; r < recorded.size(); r++) {
+		readers.push_back(std::thread([&, r]() {
+			concurrent_map::reader shared_reader = cm_shared.get_reader();
+			for(std::size_t i=0; !writer_done; i++) {
+				assert(shared_reader[std::numeric_limits<int>::min()] >= -1);
+				concurrent_map::snapshot snap = r == 0 ? cm_shared.get_snapshot() : shared_reader.m_snapshot;
+				assert(snap[std::numeric_limits<int>::min()] >= -1);
+				if(i % 16 == 0 && recorded[r].size() < 50)
+					recorded[r].push_back(snap);
+				std::this_thread::yield();
+			}
+		}));
+	}
+	writer.join();
+	for(auto& reader : readers) {
+		reader.join();
+	}
+	recorded[0].push_back(cm_shared.get_snapshot());
+	for(const auto& snapshots : recorded) {
+		for(const auto& snap : snapshots) {
+			std::vector<std::pair<int,int>> boundaries = boundaries_of(snap);
+			int latest = -1;
+			for(const auto& boundary : boundaries) {
+				latest = std::max(latest, boundary.second);
+			}
+			interval_map<int,int> im_replay(-1);
+			for(int i=0; i <= latest; i++) {
+				im_replay.assign(assignments[i].begin, assignments[i].end, i);
+			}
+			std::vector<std::pair<int,int>> expected(std::begin(im_replay.m_map), std::end(im_replay.m_map));
+			assert(boundaries == expected);
+		}
+	}
+
+
+
+
+	// This randomised test verifies that a sharded_interval_map gives the same values as an interval_map, for intervals
+	// within a shard and crossing any number of split points, and that every shard stays canonical.
+	sharded_interval_map<int,char> im_sharded(ch_init, std::vector<int>{0, 100, 101, 250, 400});
+	interval_map<int,char> im_unsharded(ch_init);
+	for(std::size_t i=0; i < max_test_steps; i++) {
+		char val = dis_char(gen);
+		int min = dis_dense(gen) - 50;
+		int max = dis_dense(gen);
+		im_sharded.assign(min,max,val);
+		im_unsharded.assign(min,max,val);
+	}
+	for(int key = -60; key < 510; key++) {
+		assert(im_sharded[key] == im_unsharded[key]);
+	}
+	for(const auto& shard : im_sharded.m_shards) {
+		for(auto it = std::begin(shard->map.m_map); std::next(it) != std::end(shard->map.m_map); ++it) {
+			assert(it->second != std::next(it)->second);
+		}
+	}
+
+
+
+
+	// This randomised test verifies that a deferred_interval_map ends up with the same boundaries as an interval_map which
+	// every assign is applied to right away. Bursts of overlapping, nested, contiguous and empty intervals are logged and
+	// resolved by reads and by flush().
+	{
+		deferred_interval_map<int,char> im_deferred(ch_init);
+		deferred_interval_map<int,char,btree_storage<4,4>> im_deferred_btree(ch_init);
+		interval_map<int,char> im_eager(ch_init);
+		for(std::size_t burst=0; burst < 100; burst++) {
+			std::size_t const burst_size = dis_dense(gen) / 5;
+			for(std::size_t i=0; i < burst_size; i++) {
+				int min = dis_dense(gen);
+				int max = min + dis_dense(gen) % 60 - 5;
+				char val = static_cast<char>('A' + dis_gap(gen));
+				im_deferred.assign(min, max, val);
+				im_deferred_btree.assign(min, max, val);
+				im_eager.assign(min, max, val);
+			}
+			if(burst % 2 == 0) {
+				im_deferred.flush();
+				assert(im_deferred.pending() == 0);
+			}
+			int key = dis_dense(gen);
+			assert(im_deferred[key] == im_eager[key] && im_deferred_btree[key] == im_eager[key]);
+			assert(im_deferred.pending() == 0 && im_deferred_btree.pending() == 0);
+			assert(im_deferred.m_map.m_map == im_eager.m_map);
+			CheckSameBoundaries(im_eager.m_map, im_deferred_btree.m_map.m_map);
+		}
+	}
+
 
-23.2.1 General container requirements 
 
-�1	Containers are objects that store other objects. They control allocation and deallocation of 
-these objects through constructors, destructors, insert and erase operations.
+	// This randomised test verifies that build_interval_map() gives the same map as replaying the intervals with assign,
+	// for any number of threads, including more threads than the intervals can be divided among.
+	{
+		std::vector<interval<int,char>> intervals;
+		for(std::size_t i=0; i < 20 * max_test_steps; i++) {
+			int min = dis_int(gen) / 1024;
+			int max = min + dis_dense(gen) * (i % 100 == 0 ? 1000 : 1) - 10;
+			intervals.push_back(interval<int,char>{min, max, static_cast<char>('A' + dis_gap(gen))});
+		}
+		// Intervals reaching the lowest and the highest key cover the borders of the first and the last range.
+		intervals[100] = interval<int,char>{std::numeric_limits<int>::min(), 0, 'B'};
+		intervals[200] = interval<int,char>{1000, std::numeric_limits<int>::max(), 'C'};
+		interval_map<int,char> im_empty = build_interval_map<int,char>(ch_init, intervals.begin(), intervals.begin(), 8);
+		assert(im_empty.size() == 1 && im_empty[0] == ch_init);
+		interval_map<int,char> im_replayed(ch_init);
+		interval_map<int,char,btree_storage<4,4>> im_replayed_btree(ch_init);
+		for(const auto& item : intervals) {
+			im_replayed.assign(item.begin, item.end, item.value);
+			im_replayed_btree.assign(item.begin, item.end, item.value);
+		}
+		for(unsigned threads : {1u, 2u, 3u, 8u, 64u}) {
+			interval_map<int,char> im_built = build_interval_map<int,char>(ch_init, intervals.begin(), intervals.end(), threads);
+			assert(im_built.m_map == im_replayed.m_map);
+			auto im_built_btree = build_interval_map<int,char,btree_storage<4,4>>(ch_init, intervals.begin(), intervals.end(), threads);
+			CheckSameBoundaries(im_replayed_btree.m_map, im_built_btree.m_map);
+		}
+	}
 
-�6	begin() returns an iterator referring to the first element in the container. end() returns 
-an iterator which is the past-the-end value for the container. If the container is empty, 
-then begin() == end();
 
-24.2.1 General Iterator Requirements
 
-�1	Iterators are a generalization of pointers that allow a C++ program to work with different 
-data structures.
+	// This randomised test verifies that interned_interval_maps give the same values and have the same boundaries as an
+	// interval_map of the values themselves, that every distinct value is stored once, and that references returned by
+	// look-ups stay valid while the value table grows.
+	{
+		interned_interval_map<int,std::string> im_interned(std::string("init"));
+		interned_interval_map<int,std::string,map_storage> im_interned_map(std::string("init"));
+		interval_map<int,std::string> im_strings(std::string("init"));
+		std::string const& init = im_interned[-1000];
+		for(std::size_t i=0; i < 10 * max_test_steps; i++) {
+			int min = dis_dense(gen);
+			int max = min + 1 + dis_dense(gen) % 50;
+			std::string val(20, static_cast<char>('a' + dis_gap(gen)));
+			if(i % 10 == 0)
+				val += std::to_string(i);
+			im_interned.assign(min, max, val);
+			im_interned_map.assign(min, max, std::string(val));
+			im_strings.assign(min, max, val);
+		}
+		assert(init == "init" && &init == &im_interned[-1000]);
+		assert(im_interned.value_count() == 1 + 4 + max_test_steps && im_interned_map.value_count() == im_interned.value_count());
+		assert(im_interned.size() == im_strings.size() && im_interned_map.size() == im_strings.size());
+		for(int key = -1; key <= 551; key++) {
+			assert(im_interned[key] == im_strings[key] && im_interned_map[key] == im_strings[key]);
+		}
 
-�2	Since iterators are an abstraction of pointers, their semantics is a generalization of most 
-of the semantics of pointers in C++. This ensures that every function template that takes 
-iterators works as well with regular pointers.
+		// A copy has its own value table, it stays valid after the map it was copied from is gone.
+		typedef interned_interval_map<int,std::string> interned_type;
+		std::unique_ptr<interned_type> im_source(new interned_type(im_interned));
+		interned_type im_copy(*im_source);
+		interned_type im_assigned(std::string("other"));
+		im_assigned = *im_source;
+		assert(&im_copy[5] != &(*im_source)[5] && &im_assigned[5] != &(*im_source)[5]);
+		im_source.reset();
+		assert(im_copy.value_count() == im_interned.value_count() && im_assigned.value_count() == im_interned.value_count());
+		for(int key = -1; key <= 551; key++) {
+			assert(im_copy[key] == im_strings[key] && im_assigned[key] == im_strings[key]);
+		}
+	}
 
-�5	Just as a regular pointer to an array guarantees that there is a pointer value pointing past 
-the last element of the array, so for any iterator type there is an iterator value that points 
-past the last element of a corresponding sequence. These values are called past-the-end values. 
-Values of an iterator i for which the expression *i is defined are called dereferenceable. 
-The library never assumes that past-the-end values are dereferenceable. Iterators can also have 
-singular values that are not associated with any sequence. [ Example: After the declaration of 
-an uninitialized pointer x (as with int* x;), x  must always be assumed to have a singular 
-value of a pointer. �end example ] Results of most expressions are undefined for singular 
-values; the only exceptions are destroying an iterator that holds a singular value, the 
-assignment of a non-singular value to an iterator that holds a singular value, and, for 
-iterators that satisfy the DefaultConstructible requirements, using a value-initialized 
-iterator as the source of a copy or move operation.
 
-�10 An invalid iterator is an iterator that may be singular. (This definition applies to pointers, 
-since pointers are iterators. The effect of dereferencing an iterator that has been invalidated 
-is undefined.)
 
-23.2.4 Associative containers
+	// These randomised tests verify interval_maps allocating their boundaries from a node_pool, a monotonic_arena and, if
+	// available, a std::pmr resource. Once a pooled map has reached its working size, the churn of assign has to be served
+	// by recycled blocks alone.
+	node_pool pool(64);
+	interval_map<int,char,map_storage,resource_allocator<std::pair<const int,char>,node_pool>> im_pooled(ch_init, pool);
+	interval_map<int,char,btree_storage<4,4>,resource_allocator<std::pair<const int,char>,node_pool>> im_pooled_btree(ch_init, pool);
+	monotonic_arena arena(256);
+	typedef interval_map<int,char,map_storage,resource_allocator<std::pair<const int,char>,monotonic_arena>> arena_map;
+	arena_map& im_arena = *arena.make<arena_map>(ch_init, arena);
+#if defined(__cpp_lib_memory_resource)
+	std::pmr::unsynchronized_pool_resource pmr_pool;
+	pmr::interval_map<int,char> im_pmr(ch_init, &pmr_pool);
+	pmr::interval_map<int,char,btree_storage<4,4>> im_pmr_btree(ch_init, &pmr_pool);
+#endif
+	interval_map<int,char> im_plain(ch_init);
+	std::size_t warm_chunks = 0;
+	for(std::size_t i=0; i < 20 * max_test_steps; i++) {
+		if(i == 10 * max_test_steps)
+			warm_chunks = pool.chunk_count();
+		char val = dis_char(gen);
+		int min = dis_dense(gen);
+		int max = min + dis_dense(gen) / 25;
+		im_pooled.assign(min,max,val);
+		im_pooled_btree.assign(min,max,val);
+		im_arena.assign(min,max,val);
+#if defined(__cpp_lib_memory_resource)
+		im_pmr.assign(min,max,val);
+		im_pmr_btree.assign(min,max,val);
+#endif
+		im_plain.assign(min,max,val);
+	}
+	assert(pool.chunk_count() <= warm_chunks + 2);
+	for(int key = -10; key < 530; key++) {
+		assert(im_pooled[key] == im_plain[key]);
+		assert(im_pooled_btree[key] == im_plain[key]);
+		assert(im_arena[key] == im_plain[key]);
+#if defined(__cpp_lib_memory_resource)
+		assert(im_pmr[key] == im_plain[key]);
+#endif
+	}
+#if defined(__cpp_lib_memory_resource)
+	// A pmr map keeps its memory resource when it is assigned to, as polymorphic_allocator does not propagate. Moving
+	// between maps with different resources moves the entries into nodes of the target's resource.
+	{
+		typedef pmr::interval_map<int,char,btree_storage<4,4>> pmr_btree_map;
+		CheckSameBoundaries(im_plain.m_map, im_pmr_btree.m_map);
+		std::pmr::unsynchronized_pool_resource other_pool;
+		pmr_btree_map im_copy(ch_init, &other_pool);
+		im_copy = im_pmr_btree;
+		assert(im_copy.m_map.get_allocator().resource() == &other_pool);
+		CheckSameBoundaries(im_plain.m_map, im_copy.m_map);
+		pmr_btree_map im_moved(std::move(im_copy));
+		assert(im_moved.m_map.get_allocator().resource() == &other_pool && im_copy.size() == 0);
+		CheckSameBoundaries(im_plain.m_map, im_moved.m_map);
+		pmr_btree_map im_other(ch_init, &pmr_pool);
+		im_other = std::move(im_moved);
+		assert(im_other.m_map.get_allocator().resource() == &pmr_pool);
+		CheckSameBoundaries(im_plain.m_map, im_other.m_map);
+		im_moved = std::move(im_other);
+		assert(im_moved.m_map.get_allocator().resource() == &other_pool);
+		im_other = pmr_btree_map(ch_init, &pmr_pool);
+		im_other.overlay(im_moved, '\0');
+		assert(im_other.m_map.get_allocator().resource() == &pmr_pool);
+		CheckSameBoundaries(im_plain.m_map, im_other.m_map);
+		im_other.m_map.swap(im_pmr_btree.m_map);
+		CheckSameBoundaries(im_plain.m_map, im_pmr_btree.m_map);
+	}
+#endif
 
-�1	Associative containers provide fast retrieval of data based on keys. The library provides four 
-basic kinds of associative containers: set, multiset, map and multimap.
 
-�4	An associative container supports unique keys if it may contain at most one element for each key. 
-Otherwise, it supports equivalent keys. The set and map classes support unique keys; the multiset 
-and multimap classes support equivalent keys.
 
-�5	For map and multimap the value type is equal to std::pair<const Key, T>. Keys in an associative 
-container are immutable.
 
-�6	iterator of an associative container is of the bidirectional iterator category.
-(i.e., an iterator i can be incremented and decremented: ++i; --i;)
+	// This randomised test verifies for_each_interval() on random ranges, including ranges beyond the last boundary.
+	// The intervals passed have to tile the range, have the values operator[] gives for their keys and be canonical.
+	for(std::size_t i=0; i < max_test_steps; i++) {
+		int a = dis_dense(gen) - 10;
+		int b = a + dis_dense(gen) / 4;
+		std::vector<interval<int,char>> tiles;
+		auto collect = [&tiles](int const& begin, int const& end, char const& value) {
+			tiles.push_back(interval<int,char>{begin, end, value});
+		};
+		for(std::size_t storage=0; storage < 2; storage++) {
+			tiles.clear();
+			if(storage == 0)
+				im_map.for_each_interval(a, b, collect);
+			else
+				im_btree.for_each_interval(a, b, collect);
+			if(!(a < b)) {
+				assert(tiles.empty());
+				continue;
+			}
+			assert(!tiles.empty() && tiles.front().begin == a && tiles.back().end == b);
+			for(std::size_t t=0; t < tiles.size(); t++) {
+				assert(tiles[t].begin < tiles[t].end);
+				assert(t == 0 || (tiles[t].begin == tiles[t-1].end && tiles[t].value != tiles[t-1].value));
+				for(int key = tiles[t].begin; key < tiles[t].end; key++) {
+					assert(im_map[key] == tiles[t].value);
+				}
+			}
+		}
+	}
 
-�9	The insert member functions (see below) shall not affect the validity of iterators and references 
-to the container, and the erase members shall invalidate only iterators and references to the erased 
-elements.
 
-�10	The fundamental property of iterators of associative containers is that they iterate through the 
-containers in the non-descending order of keys where non-descending is defined by the comparison 
-that was used to construct them.
 
-Associative container requirements (in addition to general container requirements):
+	// This randomised test verifies that combine() gives f of the values of both maps for every key and a canonical map,
+	// and that overlay() gives the same map as assigning the intervals which are not transparent one by one. Neither may
+	// search the maps from scratch. The layers hold few values, so that many combined boundaries are redundant.
+	{
+		std::uniform_int_distribution<> dis_sparse(0, 50);
+		char const transparent = '.';
+		interval_map<int,char,btree_storage<4,4>> im_layer(transparent);
+		for(std::size_t i=0; i < max_test_steps; i++) {
+			int min = dis_dense(gen);
+			int max = min + dis_sparse(gen);
+			char val = dis_sparse(gen) < 20 ? transparent : static_cast<char>('A' + dis_gap(gen));
+			im_layer.assign(min,max,val);
+
+			if(i % 100 != 0)
+				continue;
+			auto maximum = [](char a, char b) { return std::max(a, b); };
+			auto im_combined = combine(im_map, im_layer, maximum);
+			for(int key = -10; key < 600; key++) {
+				assert(im_combined[key] == std::max(im_map[key], im_layer[key]));
+			}
+			for(auto it = std::begin(im_combined.m_map); std::next(it) != std::end(im_combined.m_map); ++it) {
+				assert(it->second != std::next(it)->second);
+			}
+			interval_map<int,char,btree_storage<4,4>> im_combined_btree(ch_init);
+#if defined(INTERVAL_MAP_COUNTERS)
+			im_combined_btree.reset_counters();
+#endif
+			im_combined_btree.assign_combined(im_layer, im_map, maximum);
+#if defined(INTERVAL_MAP_COUNTERS)
+			assert(im_combined_btree.counters().searches == 0);
+			assert(im_combined_btree.counters().insertions == im_combined_btree.size());
+#endif
+			assert(im_combined_btree.size() == im_combined.size());
+			CheckSameBoundaries(im_combined.m_map, im_combined_btree.m_map);
+
+			// The last interval of the layer is transparent, so every other one can be assigned.
+			interval_map<int,char> im_over(im_map), im_replay(im_map);
+#if defined(INTERVAL_MAP_COUNTERS)
+			im_over.reset_counters();
+#endif
+			im_over.overlay(im_layer, transparent);
+#if defined(INTERVAL_MAP_COUNTERS)
+			assert(im_over.counters().searches == 0);
+#endif
+			for(auto it = std::begin(im_layer.m_map); std::next(it) != std::end(im_layer.m_map); ++it) {
+				if(it->second != transparent)
+					im_replay.assign(it->first, std::next(it)->first, it->second);
+			}
+			assert(im_over.m_map == im_replay.m_map);
+			im_over.overlay(im_over, transparent);
+			assert(im_over.m_map == im_replay.m_map);
+		}
+	}
 
-std::pair<iterator, bool> insert(std::pair<const key_type, T> const& t)
-Effects: Inserts t if and only if there is no element in the container with key equivalent to the key of t. 
-The bool component of the returned pair is true if and only if the insertion takes place, and the iterator 
-component of the pair points to the element with key equivalent to the key of t.
-Complexity: logarithmic
 
-iterator insert(const_iterator p, std::pair<const key_type, T> const& t)
-Effects: Inserts t if and only if there is no element with key equivalent to the key of t in containers with
-unique keys. Always returns the iterator pointing to the element with key equivalent to the key of t.
-Complexity: logarithmic in general, but amortized constant if t is inserted right before p.
 
-size_type erase(key_type const& k)  
-Effects: Erases all elements in the container with key equivalent to k. Returns the number of erased elements.
-Complexity: log(size of container) + number of elements with key k
+	// This randomised test verifies that cursors give the same values and boundaries as operator[] and assign(), on both
+	// storages. Near-monotone keys are used, a step back now and then, and ascending keys must not cost any search.
+	// Assigns through the map or another cursor have to make a cursor stale, and a stale cursor has to find keys again.
+	{
+		std::uniform_int_distribution<> dis_back(0, 5);
+		interval_map<int,char> im_cursor_map(ch_init), im_reference(ch_init);
+		interval_map<int,char,btree_storage<4,4>> im_cursor_btree(ch_init);
+		auto cursor_map = im_cursor_map.get_cursor();
+		auto cursor_btree = im_cursor_btree.get_cursor();
+		auto other_cursor = im_cursor_btree.get_cursor();
+		int key = 0;
+		for(std::size_t i=0; i < 10 * max_test_steps; i++) {
+			key += i % 10 == 0 ? -dis_back(gen) : dis_gap(gen);
+			int end = key + 1 + dis_gap(gen);
+			char val = static_cast<char>('A' + dis_gap(gen));
+			if(i % 50 == 0) {
+				im_cursor_btree.assign(key, end, val);
+				assert(!cursor_btree.valid() && !other_cursor.valid());
+				cursor_btree.assign(key, end, val);
+				assert(cursor_btree.valid());
+			}
+			else if(i % 50 == 25) {
+				other_cursor.assign(key, end, val);
+				assert(!cursor_btree.valid() && other_cursor.valid());
+			}
+			else {
+				cursor_btree.assign(key, end, val);
+			}
+			char moved = val;
+			cursor_map.assign(key, end, std::move(moved));
+			im_reference.assign(key, end, val);
+			assert(cursor_map[key - 1] == im_reference[key - 1] && cursor_btree[key + 2] == im_reference[key + 2]);
+		}
+		assert(im_cursor_map.m_map == im_reference.m_map);
+		CheckSameBoundaries(im_reference.m_map, im_cursor_btree.m_map);
+
+		// Walking the keys in ascending order costs no search, and at most one for assigns.
+		cursor_map = im_reference.get_cursor();
+#if defined(INTERVAL_MAP_COUNTERS)
+		im_reference.reset_counters();
+#endif
+		for(key = -1000; key < 20000; key++) {
+			assert(cursor_map[key] == im_cursor_map[key]);
+		}
+#if defined(INTERVAL_MAP_COUNTERS)
+		assert(im_reference.counters().searches == 0);
+		im_reference.reset_counters();
+#endif
+		for(key = 0; key < 20000; key += 2) {
+			cursor_map.assign(key, key + 1, 'Z');
+		}
+#if defined(INTERVAL_MAP_COUNTERS)
+		assert(im_reference.counters().searches <= 1);
+#endif
+		for(key = 0; key < 20000; key++) {
+			assert(im_reference[key] == (key % 2 == 0 ? 'Z' : im_cursor_map[key]));
+		}
+	}
 
-iterator erase(const_iterator q) 
-Effects: Erases the element pointed to by q. Returns an iterator pointing to the element immediately following 
-q prior to the element being erased. If no such element exists, returns end().
-Complexity: Amortized constant
 
-iterator erase(const_iterator q1, const_iterator q2)
-Effects: Erases all the elements in the left-inclusive and right-exclusive range [q1,q2). Returns q2.
-Complexity: Amortized O(N) where N has the value distance(q1, q2).
 
-void clear() 
-Effects: erase(begin(), end())
-Post-Condition: empty() returns true
-Complexity: linear in size().
+#if defined(__unix__) || defined(__APPLE__)
+	// This test writes interval maps to a file and verifies that the mapped file gives the same values as the map, and that
+	// files which are truncated or do not hold a canonical map are rejected.
+	{
+		typedef mapped_interval_map<int,char> mapped_type;
+		char const* path = "IntervalMapTest.imap";
+		for(std::size_t storage=0; storage < 2; storage++) {
+			bool written = storage == 0 ? mapped_type::write(im_map, path) : mapped_type::write(im_btree, path);
+			assert(written);
+			mapped_type mapped;
+			assert(mapped.open(path) && mapped.size() == im_map.m_map.size());
+			for(int key = -10; key < 600; key++) {
+				assert(mapped[key] == im_map[key]);
+			}
+			mapped_type moved(std::move(mapped));
+			assert(!mapped.is_open() && moved.is_open() && moved[250] == im_map[250]);
+		}
 
-iterator find(key_type const& k);
-Effects: Returns an iterator pointing to an element with the key equivalent to k, or end() if such an element is not found
-Complexity: logarithmic
+		// Writing a map over a file which is mapped replaces the file, the mapping keeps the previous contents.
+		{
+			mapped_type previous;
+			assert(previous.open(path));
+			interval_map<int,char> im_single(ch_init);
+			assert(mapped_type::write(im_single, path));
+			for(int key = -10; key < 600; key++) {
+				assert(previous[key] == im_map[key]);
+			}
+			mapped_type current;
+			assert(current.open(path) && current.size() == 1 && current[250] == ch_init);
+			assert(mapped_type::write(im_map, path));
+		}
 
-size_type count(key_type const& k) 
-Effects: Returns the number of elements with key equivalent to k
-Complexity: log(size of map) + number of elements with key equivalent to k
+		std::vector<char> bytes;
+		std::FILE* file = std::fopen(path, "rb");
+		for(int c; (c = std::fgetc(file)) != EOF; )
+			bytes.push_back(static_cast<char>(c));
+		std::fclose(file);
+		auto rewrite = [path](std::vector<char> const& contents) {
+			std::FILE* file = std::fopen(path, "wb");
+			std::fwrite(contents.data(), 1, contents.size(), file);
+			std::fclose(file);
+		};
+		std::size_t const count = im_map.m_map.size();
+		assert(count >= 3);
+		mapped_type mapped;
+
+		rewrite(std::vector<char>(bytes.begin(), bytes.end() - 1));
+		assert(!mapped.open(path) && !mapped.is_open());
+
+		std::vector<char> unsorted = bytes;
+		int* keys = reinterpret_cast<int*>(unsorted.data() + mapped_type::keys_offset());
+		std::swap(keys[1], keys[2]);
+		rewrite(unsorted);
+		assert(!mapped.open(path) && mapped.open(path, false));
+
+		std::vector<char> redundant = bytes;
+		char* values = redundant.data() + mapped_type::values_offset(count);
+		values[1] = values[0];
+		rewrite(redundant);
+		assert(!mapped.open(path) && mapped.open(path, false));
+
+		rewrite(bytes);
+		assert(mapped.open(path) && mapped.size() == count);
+
+		std::remove(path);
+	}
+#endif
+
+
+
+#if defined(INTERVAL_MAP_COUNTERS)
+	// This randomised test verifies that no assign or operator[] call exceeds its budget of operations on keys and values,
+	// searches, insertions and allocations, see CheckOperationBudget(). Some of the intervals are empty.
+	{
+		typedef counted<int> key_type;
+		typedef counted<char> value_type;
+		typedef resource_allocator<std::pair<const key_type,value_type>, counting_resource> counting_allocator;
+		counting_resource resource;
+		interval_map<key_type,value_type,map_storage,counting_allocator> im_counted(value_type('A'), counting_allocator(resource));
+		interval_map<key_type,value_type,btree_storage<>> im_counted_btree(value_type('A'));
+		for(std::size_t i=0; i < 10 * max_test_steps; i++) {
+			int min = dis_dense(gen);
+			int max = std::min(dis_dense(gen), min + 50) - 10;
+			char val = static_cast<char>('A' + dis_gap(gen));
+			CheckOperationBudget(im_counted, min, max, val, i % 2 == 0, &resource);
+			CheckOperationBudget(im_counted_btree, min, max, val, i % 2 == 0, nullptr);
+		}
+		for(int key = -1; key <= 500; key++) {
+			assert(im_counted[key_type(key)] == im_counted_btree[key_type(key)]);
+		}
 
-iterator lower_bound(key_type const& k)
-Effects: Returns an iterator pointing to the first element with key not less than k, or end() if such an element is not found.
-Complexity: logarithmic
+		// Values owning heap memory, in a B+-tree with tiny nodes, so that inserting a copy of a stored value often
+		// splits the leaf which holds it.
+		typedef counted<std::string> string_type;
+		interval_map<key_type,string_type> im_counted_strings(string_type(std::string(30, 'A')));
+		interval_map<key_type,string_type,btree_storage<4,4>> im_counted_strings_btree(string_type(std::string(30, 'A')));
+		for(std::size_t i=0; i < 10 * max_test_steps; i++) {
+			int min = dis_dense(gen);
+			int max = std::min(dis_dense(gen), min + 50) - 10;
+			std::string val(30, static_cast<char>('A' + dis_gap(gen)));
+			CheckOperationBudget(im_counted_strings, min, max, val, i % 2 == 0, nullptr);
+			CheckOperationBudget(im_counted_strings_btree, min, max, val, i % 2 == 0, nullptr);
+			CheckSameBoundaries(im_counted_strings.m_map, im_counted_strings_btree.m_map);
+		}
+	}
+#endif
 
-iterator upper_bound(key_type const& k)
-Effects: Returns an iterator pointing to the first element with key greater than k, or end() if such an element is not found.
-Complexity: logarithmic
+	std::cout << "Test has completed successfully!" << std::endl;
+}
 
-23.4.1 Class template map
-
-�1 	A map is an associative container that supports unique keys (contains at most one of each key value) and provides 
-for fast retrieval of values of another type T based on the keys. The map class supports bidirectional iterators.
-
-23.4.1.2 map element access
-
-T& operator[](const key_type& x);
-Effects: If there is no key equivalent to x in the map, inserts value_type(x, T()) into the map. 
-Returns: A reference to the mapped_type corresponding to x in *this.
-Complexity: logarithmic.
-
-T& at(const key_type& x);
-const T& at(const key_type& x) const;
-Returns: A reference to the element whose key is equivalent to x.
-Throws: An exception object of type out_of_range if no such element is present.
-Complexity: logarithmic.
-*/
+int main() {
+	IntervalMapTest();
+	return 0;
+}
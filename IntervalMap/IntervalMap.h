@@ -0,0 +1,2779 @@
+#ifndef INTERVAL_MAP_H
+#define INTERVAL_MAP_H
+
+#include <assert.h>
+#include <map>
+#include <limits>
+#include <random>
+#include <memory>
+#if defined(__has_include)
+#if __cplusplus >= 201703L && __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
+#endif
+#include <mutex>
+#include <thread>
+#include <iterator>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <queue>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+// interval_map<K,V> is a data structure that efficiently associates intervals of keys of type K with values of type V. 
+// Your task is to implement the assign member function of this data structure, which is outlined below. 
+
+// interval_map<K, V> is implemented on top of std::map. In case you are not entirely sure which functions std::map provides,
+// what they do and which guarantees they provide, we have attached an excerpt of the C++1x draft standard at the end of this
+// file for your convenience. 
+
+// Each key-value-pair (k,v) in the m_map member means that the value v is associated to the interval from k (including) to
+// the next key (excluding) in m_map.
+// Example: the std::map (0,'A'), (3,'B'), (5,'A') represents the mapping
+// 0 -> 'A'
+// 1 -> 'A'
+// 2 -> 'A'
+// 3 -> 'B'
+// 4 -> 'B'
+// 5 -> 'A' 
+// 6 -> 'A'
+// 7 -> 'A'
+// ... all the way to numeric_limits<key>::max()
+
+// The representation in m_map must be canonical, that is, consecutive map entries must not have the same value: 
+// ..., (0,'A'), (3,'A'), ... is not allowed.
+// Initially, the whole range of K is associated with a given initial value, passed to the constructor.
+
+// Key type K
+// - besides being copyable and assignable, is less-than comparable via operator< ;
+// - is bounded below, with the lowest value being std::numeric_limits<K>::min();
+// - does not implement any other operations, in particular no equality comparison or arithmetic operators.
+
+// Value type V
+// - besides being copyable and assignable, is equality-comparable via operator== ;
+// - does not implement any other operations.
+
+// Storage policies.
+// interval_map keeps its boundaries in an ordered associative container selected by the Storage template parameter,
+// which allocates its nodes through the Allocator template parameter of interval_map.
+// The container has to provide the following subset of the std::map interface: begin(), end(), size(), lower_bound(),
+// upper_bound(), emplace_hint(hint, key, value) and erase(first, last), with bidirectional iterators exposing
+// ->first and ->second. interval_map never relies on iterators staying valid across an insert or an erase, other than
+// the iterators returned by these calls, so node based and array based containers can be used alike.
+// The policy itself provides replace_key(map, it, key), changing the key of an item in place of erasing it and
+// inserting a new one, where key keeps the order of the items. It must keep all other iterators valid.
+//
+// - map_storage keeps the boundaries in a std::map (a red-black tree with one heap node per boundary). This is the default.
+// - btree_storage keeps the boundaries in a B+-tree whose nodes store the keys in contiguous arrays. A search touches
+//   O(log_B N) nodes instead of O(log N), which for large maps means far fewer cache misses per operator[].
+
+// Storage of raw, uninitialised slots for at most N objects of type T. The owning node constructs and destroys the
+// objects explicitly, so that neither K nor V has to be default constructible.
+template<class T, std::size_t N>
+struct slot_array {
+	alignas(T) unsigned char m_bytes[N * sizeof(T)];
+
+	T* data() { return reinterpret_cast<T*>(m_bytes); }
+	T const* data() const { return reinterpret_cast<T const*>(m_bytes); }
+	T& operator[](std::size_t i) { return data()[i]; }
+	T const& operator[](std::size_t i) const { return data()[i]; }
+};
+
+// Move the object at src into the uninitialised slot dst, ending the lifetime of the object at src.
+// src and dst must be different slots.
+template<class T>
+void relocate_slot(T* src, T* dst) {
+	assert(src != dst);
+	::new(static_cast<void*>(dst)) T(std::move(*src));
+	src->~T();
+}
+
+// B+-tree with the std::map subset described above.
+// Entries live in leaves only, sorted, with keys and values in two parallel arrays so that the in-node binary search
+// reads nothing but keys. Leaves are doubly linked to make iteration O(1) per step. Inner nodes hold separator keys:
+// all keys in children[i] are lower than keys[i], which is not greater than any key in children[i+1].
+// Every node except the root is kept at least a quarter full, thus the height is O(log_B N).
+// Unlike std::map, insert and erase invalidate all iterators except the returned one.
+// Nodes are allocated through Allocator rebound to the node types.
+template<class K, class V, std::size_t LeafSlots, std::size_t InnerSlots, class Allocator = std::allocator<std::pair<const K,V>>>
+class btree_map {
+	static_assert(LeafSlots >= 4 && InnerSlots >= 4, "B+-tree nodes need at least 4 slots");
+
+	struct inner_node;
+
+	struct node_base {
+		inner_node* parent;
+		std::size_t count; // number of entries in a leaf, number of separator keys in an inner node
+		bool is_leaf;
+	};
+
+	struct leaf_node : node_base {
+		leaf_node* prev;
+		leaf_node* next;
+		slot_array<K,LeafSlots> keys;
+		slot_array<V,LeafSlots> values;
+	};
+
+	struct inner_node : node_base {
+		slot_array<K,InnerSlots> keys;
+		node_base* children[InnerSlots + 1];
+	};
+
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<leaf_node> leaf_allocator;
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<inner_node> inner_allocator;
+
+public:
+	typedef K key_type;
+	typedef V mapped_type;
+	typedef std::pair<const K,V> value_type;
+	typedef std::size_t size_type;
+	typedef Allocator allocator_type;
+
+	// Iterators address an entry by its leaf and its index in the leaf. The past-the-end iterator addresses the slot
+	// after the last entry of the last leaf, so that it can be decremented like the one of std::map.
+	// Dereferencing yields a pair of references into the leaf arrays rather than a reference to a stored std::pair.
+	template<bool IsConst>
+	class basic_iterator {
+		friend class btree_map;
+		template<bool> friend class basic_iterator;
+
+		leaf_node* m_leaf;
+		std::size_t m_index;
+
+		basic_iterator(leaf_node* leaf, std::size_t index) : m_leaf(leaf), m_index(index) {}
+
+	public:
+		struct reference {
+			K const& first;
+			typename std::conditional<IsConst, V const&, V&>::type second;
+		};
+
+		struct pointer {
+			reference m_ref;
+			reference const* operator->() const { return &m_ref; }
+		};
+
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef std::pair<const K,V> value_type;
+		typedef std::ptrdiff_t difference_type;
+
+		basic_iterator() : m_leaf(nullptr), m_index(0) {}
+
+		// Mutable iterators convert to constant ones.
+		template<bool C, class = typename std::enable_if<IsConst && !C>::type>
+		basic_iterator(basic_iterator<C> const& other) : m_leaf(other.m_leaf), m_index(other.m_index) {}
+
+		reference operator*() const { return reference{m_leaf->keys[m_index], m_leaf->values[m_index]}; }
+		pointer operator->() const { return pointer{**this}; }
+
+		basic_iterator& operator++() {
+			if(++m_index == m_leaf->count && m_leaf->next) {
+				m_leaf = m_leaf->next;
+				m_index = 0;
+			}
+			return *this;
+		}
+
+		basic_iterator& operator--() {
+			if(m_index == 0) {
+				m_leaf = m_leaf->prev;
+				m_index = m_leaf->count;
+			}
+			--m_index;
+			return *this;
+		}
+
+		basic_iterator operator++(int) { basic_iterator it = *this; ++*this; return it; }
+		basic_iterator operator--(int) { basic_iterator it = *this; --*this; return it; }
+
+		template<bool C>
+		bool operator==(basic_iterator<C> const& other) const { return m_leaf == other.m_leaf && m_index == other.m_index; }
+		template<bool C>
+		bool operator!=(basic_iterator<C> const& other) const { return !(*this == other); }
+	};
+
+	typedef basic_iterator<false> iterator;
+	typedef basic_iterator<true> const_iterator;
+
+	explicit btree_map(Allocator const& alloc = Allocator()) : m_alloc(alloc) {
+		init();
+	}
+
+	btree_map(btree_map const& other)
+		: btree_map(other, std::allocator_traits<Allocator>::select_on_container_copy_construction(other.m_alloc)) {}
+
+	btree_map(btree_map const& other, Allocator const& alloc) : m_alloc(alloc) {
+		init();
+		for(auto it = other.begin(); it != other.end(); ++it)
+			insert_at(m_last, m_last->count, it->first, it->second);
+	}
+
+	// The nodes of other are taken over, other is left empty.
+	btree_map(btree_map&& other) : m_alloc(other.m_alloc) {
+		leaf_node* empty = other.make_leaf();
+		init_from(other, std::false_type());
+		other.init(empty);
+	}
+
+	// The allocators follow propagate_on_container_copy_assignment, propagate_on_container_move_assignment and
+	// propagate_on_container_swap, like in the standard containers. E.g. std::pmr::polymorphic_allocator is never
+	// propagated, so a map keeps its memory resource when it is assigned to.
+	btree_map& operator=(btree_map const& other) {
+		if(this != &other) {
+			typedef typename std::allocator_traits<Allocator>::propagate_on_container_copy_assignment propagate;
+			btree_map copy(other, propagate::value ? other.m_alloc : m_alloc);
+			take_nodes(copy, propagate());
+		}
+		return *this;
+	}
+
+	// The nodes of other are taken over if the allocator propagates or both allocators are equal, otherwise the
+	// entries are moved into nodes from the allocator of this map.
+	btree_map& operator=(btree_map&& other) {
+		typedef typename std::allocator_traits<Allocator>::propagate_on_container_move_assignment propagate;
+		if(this == &other)
+			return *this;
+		if(propagate::value || m_alloc == other.m_alloc) {
+			take_nodes(other, propagate());
+		}
+		else {
+			btree_map moved(m_alloc);
+			for(auto it = other.begin(); it != other.end(); ++it)
+				moved.insert_at(moved.m_last, moved.m_last->count, it->first, std::move(it->second));
+			take_nodes(moved, std::false_type());
+		}
+		return *this;
+	}
+
+	~btree_map() {
+		destroy_subtree(m_root);
+	}
+
+	// Unless the allocator propagates on swap, both maps must have equal allocators, as for the standard containers.
+	void swap(btree_map& other) {
+		typedef typename std::allocator_traits<Allocator>::propagate_on_container_swap propagate;
+		assert(propagate::value || m_alloc == other.m_alloc);
+		swap_allocators(other, propagate());
+		swap_nodes(other);
+	}
+
+	iterator begin() { return iterator(m_first, 0); }
+	iterator end() { return iterator(m_last, m_last->count); }
+	const_iterator begin() const { return const_iterator(m_first, 0); }
+	const_iterator end() const { return const_iterator(m_last, m_last->count); }
+
+	size_type size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+	// Complexity: O(log_B N) node visits and O(log N) comparisons
+	iterator lower_bound(K const& key) {
+		leaf_node* leaf = find_leaf(key);
+		return normalize(leaf, lower_index(leaf->keys.data(), leaf->count, key));
+	}
+
+	const_iterator lower_bound(K const& key) const {
+		return const_cast<btree_map*>(this)->lower_bound(key);
+	}
+
+	iterator upper_bound(K const& key) {
+		leaf_node* leaf = find_leaf(key);
+		return normalize(leaf, upper_index(leaf->keys.data(), leaf->count, key));
+	}
+
+	const_iterator upper_bound(K const& key) const {
+		return const_cast<btree_map*>(this)->upper_bound(key);
+	}
+
+	// Complexity: O(log_B N) node visits, plus amortized O(1) node splits
+	std::pair<iterator,bool> insert(value_type const& value) {
+		leaf_node* leaf = find_leaf(value.first);
+		std::size_t index = lower_index(leaf->keys.data(), leaf->count, value.first);
+		if(index < leaf->count && !(value.first < leaf->keys[index]))
+			return std::make_pair(iterator(leaf,index), false);
+		return std::make_pair(insert_at(leaf, index, value.first, value.second), true);
+	}
+
+	// Like the above, but moving the key and the value out of an rvalue, e.g. a std::pair<K,V>.
+	template<class P>
+	std::pair<iterator,bool> insert(P&& value) {
+		leaf_node* leaf = find_leaf(value.first);
+		std::size_t index = lower_index(leaf->keys.data(), leaf->count, value.first);
+		if(index < leaf->count && !(value.first < leaf->keys[index]))
+			return std::make_pair(iterator(leaf,index), false);
+		return std::make_pair(insert_at(leaf, index, std::forward<P>(value).first, std::forward<P>(value).second), true);
+	}
+
+	// Complexity: amortized constant if value is inserted right before hint and hint is not the first entry of its leaf,
+	// O(log_B N) node visits without any search otherwise, if value is inserted right before hint; the same as the
+	// unhinted insert if it is not.
+	iterator insert(const_iterator hint, value_type const& value) {
+		if(accept_hint(hint.m_leaf, hint.m_index, value.first))
+			return insert_at(hint.m_leaf, hint.m_index, value.first, value.second);
+		return insert(value).first;
+	}
+
+	template<class P>
+	iterator insert(const_iterator hint, P&& value) {
+		if(accept_hint(hint.m_leaf, hint.m_index, value.first))
+			return insert_at(hint.m_leaf, hint.m_index, std::forward<P>(value).first, std::forward<P>(value).second);
+		return insert(std::forward<P>(value)).first;
+	}
+
+	// Insert an entry constructed from key and val, like insert(hint, value) does, without constructing a value_type.
+	template<class VArg>
+	iterator emplace_hint(const_iterator hint, K const& key, VArg&& val) {
+		if(accept_hint(hint.m_leaf, hint.m_index, key))
+			return insert_at(hint.m_leaf, hint.m_index, key, std::forward<VArg>(val));
+		leaf_node* leaf = find_leaf(key);
+		std::size_t index = lower_index(leaf->keys.data(), leaf->count, key);
+		if(index < leaf->count && !(key < leaf->keys[index]))
+			return iterator(leaf,index);
+		return insert_at(leaf, index, key, std::forward<VArg>(val));
+	}
+
+	// Change the key of the entry at it to key, which has to lie between the keys of the entries before and after it.
+	// The entry stays in its slot, so all iterators stay valid. The separators next to its leaf are adjusted if the
+	// entry is the first or the last one of the leaf.
+	// Complexity: constant if the entry is neither the first nor the last one of its leaf, otherwise O(log_B N) node visits
+	iterator replace_key(const_iterator it, K const& key) {
+		leaf_node* leaf = it.m_leaf;
+		std::size_t index = it.m_index;
+		if(index == 0 && leaf->prev) {
+			K& separator = separator_before(leaf);
+			if(key < separator)
+				separator = key;
+		}
+		if(index + 1 == leaf->count && leaf->next) {
+			// The separator has to stay greater than the key, the first key of the next leaf is.
+			K& separator = separator_before(leaf->next);
+			if(!(key < separator))
+				separator = leaf->next->keys[0];
+		}
+		leaf->keys[index] = key;
+		return iterator(leaf, index);
+	}
+
+	// Complexity: amortized O(N) where N is the number of entries erased, plus O(log_B N) for rebalancing
+	iterator erase(const_iterator first, const_iterator last) {
+		if(first == last)
+			return iterator(last.m_leaf, last.m_index);
+
+		leaf_node* head = first.m_leaf;
+		leaf_node* tail = last.m_leaf;
+		iterator position;
+		if(head == tail) {
+			erase_entries(head, first.m_index, last.m_index);
+			position = iterator(head, first.m_index);
+		}
+		else {
+			// Whole leaves between the first and the last one are dropped without moving their entries.
+			erase_entries(head, first.m_index, head->count);
+			while(head->next != tail)
+				remove_leaf(head->next);
+			erase_entries(tail, 0, last.m_index);
+			position = iterator(tail, 0);
+			// Rebalancing the tail can only merge it into the head, never the other way round, so head stays valid.
+			rebalance_leaf(tail, position);
+		}
+		rebalance_leaf(head, position);
+		return normalize(position.m_leaf, position.m_index);
+	}
+
+	allocator_type get_allocator() const {
+		return m_alloc;
+	}
+
+private:
+	Allocator m_alloc;
+	node_base* m_root;
+	leaf_node* m_first;
+	leaf_node* m_last;
+	std::size_t m_size;
+
+	void init() {
+		init(make_leaf());
+	}
+
+	void init(leaf_node* empty) {
+		m_root = m_first = m_last = empty;
+		m_size = 0;
+	}
+
+	void swap_nodes(btree_map& other) {
+		std::swap(m_root, other.m_root);
+		std::swap(m_first, other.m_first);
+		std::swap(m_last, other.m_last);
+		std::swap(m_size, other.m_size);
+	}
+
+	void swap_allocators(btree_map& other, std::true_type) {
+		using std::swap;
+		swap(m_alloc, other.m_alloc);
+	}
+
+	void swap_allocators(btree_map&, std::false_type) {}
+
+	// Free the nodes of this map and take over the ones of other, which is left empty. Unless the allocator of other is
+	// taken over too, both allocators have to be equal.
+	template<class Propagate>
+	void take_nodes(btree_map& other, Propagate propagate) {
+		leaf_node* empty = other.make_leaf();
+		destroy_subtree(m_root);
+		init_from(other, propagate);
+		other.init(empty);
+	}
+
+	void init_from(btree_map& other, std::true_type) {
+		m_alloc = other.m_alloc;
+		init_from(other, std::false_type());
+	}
+
+	void init_from(btree_map& other, std::false_type) {
+		m_root = other.m_root;
+		m_first = other.m_first;
+		m_last = other.m_last;
+		m_size = other.m_size;
+	}
+
+	leaf_node* make_leaf() {
+		leaf_allocator alloc(m_alloc);
+		leaf_node* leaf = ::new(static_cast<void*>(std::allocator_traits<leaf_allocator>::allocate(alloc, 1))) leaf_node;
+		leaf->parent = nullptr;
+		leaf->count = 0;
+		leaf->is_leaf = true;
+		leaf->prev = leaf->next = nullptr;
+		return leaf;
+	}
+
+	inner_node* make_inner() {
+		inner_allocator alloc(m_alloc);
+		inner_node* inner = ::new(static_cast<void*>(std::allocator_traits<inner_allocator>::allocate(alloc, 1))) inner_node;
+		inner->parent = nullptr;
+		inner->count = 0;
+		inner->is_leaf = false;
+		return inner;
+	}
+
+	// Free a node whose slots are already destroyed.
+	void free_node(leaf_node* leaf) {
+		leaf_allocator alloc(m_alloc);
+		leaf->~leaf_node();
+		std::allocator_traits<leaf_allocator>::deallocate(alloc, leaf, 1);
+	}
+
+	void free_node(inner_node* inner) {
+		inner_allocator alloc(m_alloc);
+		inner->~inner_node();
+		std::allocator_traits<inner_allocator>::deallocate(alloc, inner, 1);
+	}
+
+	void destroy_subtree(node_base* node) {
+		if(node->is_leaf) {
+			leaf_node* leaf = static_cast<leaf_node*>(node);
+			destroy_range(leaf->keys.data(), 0, leaf->count);
+			destroy_range(leaf->values.data(), 0, leaf->count);
+			free_node(leaf);
+		}
+		else {
+			inner_node* inner = static_cast<inner_node*>(node);
+			for(std::size_t i = 0; i <= inner->count; ++i)
+				destroy_subtree(inner->children[i]);
+			destroy_range(inner->keys.data(), 0, inner->count);
+			free_node(inner);
+		}
+	}
+
+	template<class T>
+	static void destroy_range(T* slots, std::size_t first, std::size_t last) {
+		for(std::size_t i = first; i < last; ++i)
+			slots[i].~T();
+	}
+
+	// Move the objects in [first, count) one slot to the right.
+	template<class T>
+	static void shift_right(T* slots, std::size_t first, std::size_t count) {
+		for(std::size_t i = count; i > first; --i)
+			relocate_slot(slots + i - 1, slots + i);
+	}
+
+	// Move the objects in [first + n, count) n slots to the left, into slots that are already destroyed.
+	// Shifting by zero slots is a no-op, it must not relocate an object onto itself.
+	template<class T>
+	static void shift_left(T* slots, std::size_t first, std::size_t n, std::size_t count) {
+		if(n == 0)
+			return;
+		for(std::size_t i = first + n; i < count; ++i)
+			relocate_slot(slots + i, slots + i - n);
+	}
+
+	// Iterators pointing one past the last entry of a leaf other than the last one are moved to the next leaf,
+	// so that every position has exactly one representation.
+	static iterator normalize(leaf_node* leaf, std::size_t index) {
+		if(index == leaf->count && leaf->next)
+			return iterator(leaf->next, 0);
+		return iterator(leaf, index);
+	}
+
+	leaf_node* find_leaf(K const& key) const {
+		node_base* node = m_root;
+		while(!node->is_leaf) {
+			inner_node* inner = static_cast<inner_node*>(node);
+			node = inner->children[upper_index(inner->keys.data(), inner->count, key)];
+		}
+		return static_cast<leaf_node*>(node);
+	}
+
+	// Number of the sorted keys lower than (lower_index) or not greater than (upper_index) the given key.
+	// Arithmetic keys are compared with all keys of the node without branching. Compilers turn such a loop into SIMD
+	// compares, and for node sized arrays it is much faster than a binary search, whose branches are unpredictable.
+	// Other keys may be expensive to compare, so they are binary searched.
+	static std::size_t lower_index(K const* keys, std::size_t count, K const& key) {
+		return lower_index(keys, count, key, std::is_arithmetic<K>());
+	}
+
+	static std::size_t upper_index(K const* keys, std::size_t count, K const& key) {
+		return upper_index(keys, count, key, std::is_arithmetic<K>());
+	}
+
+	static std::size_t lower_index(K const* keys, std::size_t count, K const& key, std::true_type) {
+		std::size_t index = 0;
+		for(std::size_t i = 0; i < count; ++i)
+			index += keys[i] < key;
+		return index;
+	}
+
+	static std::size_t upper_index(K const* keys, std::size_t count, K const& key, std::true_type) {
+		std::size_t index = 0;
+		for(std::size_t i = 0; i < count; ++i)
+			index += !(key < keys[i]);
+		return index;
+	}
+
+	static std::size_t lower_index(K const* keys, std::size_t count, K const& key, std::false_type) {
+		return std::lower_bound(keys, keys + count, key) - keys;
+	}
+
+	static std::size_t upper_index(K const* keys, std::size_t count, K const& key, std::false_type) {
+		return std::upper_bound(keys, keys + count, key) - keys;
+	}
+
+	static std::size_t child_index(inner_node* parent, node_base* child) {
+		return std::find(parent->children, parent->children + parent->count + 1, child) - parent->children;
+	}
+
+	// Whether key can be inserted at index of leaf, i.e. between the entries before and at that position.
+	// Inserting in the middle or at the end of a leaf never affects the separators in the inner nodes. A key inserted at
+	// the front of a leaf may be lower than the separator between the leaf and its predecessor, which is lowered to the
+	// key then. The keys of the predecessor stay lower than the separator, as they are lower than the key.
+	bool accept_hint(leaf_node* leaf, std::size_t index, K const& key) {
+		if(index < leaf->count && !(key < leaf->keys[index]))
+			return false;
+		if(index > 0)
+			return leaf->keys[index-1] < key;
+		if(leaf->prev) {
+			if(!(leaf->prev->keys[leaf->prev->count-1] < key))
+				return false;
+			K& separator = separator_before(leaf);
+			if(key < separator)
+				separator = key;
+		}
+		return true;
+	}
+
+	// The separator between leaf and its predecessor, which is in the lowest ancestor of which leaf is not in the
+	// leftmost subtree.
+	static K& separator_before(leaf_node* leaf) {
+		node_base* node = leaf;
+		std::size_t child = 0;
+		while((child = child_index(node->parent, node)) == 0)
+			node = node->parent;
+		return node->parent->keys[child - 1];
+	}
+
+	// val may refer to a value of this leaf, e.g. when an entry is inserted with a copy of the value before it. Splitting
+	// the leaf or shifting its entries would move that value away before it is read, so it is copied out first.
+	template<class KArg, class VArg>
+	iterator insert_at(leaf_node* leaf, std::size_t index, KArg&& key, VArg&& val) {
+		if(in_values(leaf, val)) {
+			V value(std::forward<VArg>(val));
+			return insert_at(leaf, index, std::forward<KArg>(key), std::move(value));
+		}
+		if(leaf->count == LeafSlots) {
+			leaf_node* right = split_leaf(leaf);
+			if(index > leaf->count) {
+				index -= leaf->count;
+				leaf = right;
+			}
+		}
+		shift_right(leaf->keys.data(), index, leaf->count);
+		shift_right(leaf->values.data(), index, leaf->count);
+		::new(static_cast<void*>(leaf->keys.data() + index)) K(std::forward<KArg>(key));
+		::new(static_cast<void*>(leaf->values.data() + index)) V(std::forward<VArg>(val));
+		++leaf->count;
+		++m_size;
+		return iterator(leaf, index);
+	}
+
+	static bool in_values(leaf_node const* leaf, V const& val) {
+		std::less<V const*> less;
+		return !less(std::addressof(val), leaf->values.data()) && less(std::addressof(val), leaf->values.data() + leaf->count);
+	}
+
+	template<class VArg>
+	static bool in_values(leaf_node const*, VArg const&) {
+		return false;
+	}
+
+	// Move the upper half of a full leaf into a new right sibling and return the sibling.
+	leaf_node* split_leaf(leaf_node* leaf) {
+		leaf_node* right = make_leaf();
+		std::size_t keep = leaf->count / 2;
+		for(std::size_t i = keep; i < leaf->count; ++i) {
+			relocate_slot(leaf->keys.data() + i, right->keys.data() + i - keep);
+			relocate_slot(leaf->values.data() + i, right->values.data() + i - keep);
+		}
+		right->count = leaf->count - keep;
+		leaf->count = keep;
+
+		right->prev = leaf;
+		right->next = leaf->next;
+		if(leaf->next)
+			leaf->next->prev = right;
+		else
+			m_last = right;
+		leaf->next = right;
+
+		insert_into_parent(leaf, right->keys[0], right);
+		return right;
+	}
+
+	// Move the keys and children above the middle key of a full inner node into a new right sibling, push the middle
+	// key up into the parent and return the sibling.
+	inner_node* split_inner(inner_node* node) {
+		inner_node* right = make_inner();
+		std::size_t mid = node->count / 2;
+		for(std::size_t i = mid + 1; i < node->count; ++i)
+			relocate_slot(node->keys.data() + i, right->keys.data() + i - mid - 1);
+		for(std::size_t i = mid + 1; i <= node->count; ++i) {
+			right->children[i - mid - 1] = node->children[i];
+			node->children[i]->parent = right;
+		}
+		right->count = node->count - mid - 1;
+
+		K separator(std::move(node->keys[mid]));
+		node->keys[mid].~K();
+		node->count = mid;
+
+		insert_into_parent(node, separator, right);
+		return right;
+	}
+
+	// Register right as the sibling directly following left, separated by the given key.
+	void insert_into_parent(node_base* left, K const& separator, node_base* right) {
+		inner_node* parent = left->parent;
+		if(!parent) {
+			inner_node* root = make_inner();
+			::new(static_cast<void*>(root->keys.data())) K(separator);
+			root->children[0] = left;
+			root->children[1] = right;
+			root->count = 1;
+			left->parent = right->parent = root;
+			m_root = root;
+			return;
+		}
+
+		std::size_t index = child_index(parent, left);
+		if(parent->count == InnerSlots) {
+			inner_node* sibling = split_inner(parent);
+			if(index > parent->count) {
+				index -= parent->count + 1;
+				parent = sibling;
+			}
+		}
+
+		shift_right(parent->keys.data(), index, parent->count);
+		std::copy_backward(parent->children + index + 1, parent->children + parent->count + 1, parent->children + parent->count + 2);
+		::new(static_cast<void*>(parent->keys.data() + index)) K(separator);
+		parent->children[index + 1] = right;
+		right->parent = parent;
+		++parent->count;
+	}
+
+	// Remove the child at the given index together with the separator next to it. The caller frees the child.
+	static void remove_child(inner_node* parent, std::size_t index) {
+		assert(parent->count > 0);
+		std::size_t key_index = index > 0 ? index - 1 : 0;
+		parent->keys[key_index].~K();
+		shift_left(parent->keys.data(), key_index, 1, parent->count);
+		std::copy(parent->children + index + 1, parent->children + parent->count + 1, parent->children + index);
+		--parent->count;
+	}
+
+	void erase_entries(leaf_node* leaf, std::size_t first, std::size_t last) {
+		if(first == last)
+			return;
+		destroy_range(leaf->keys.data(), first, last);
+		destroy_range(leaf->values.data(), first, last);
+		shift_left(leaf->keys.data(), first, last - first, leaf->count);
+		shift_left(leaf->values.data(), first, last - first, leaf->count);
+		leaf->count -= last - first;
+		m_size -= last - first;
+	}
+
+	// Drop a leaf that is neither the first nor the last one.
+	void remove_leaf(leaf_node* leaf) {
+		erase_entries(leaf, 0, leaf->count);
+		leaf->prev->next = leaf->next;
+		leaf->next->prev = leaf->prev;
+		inner_node* parent = leaf->parent;
+		remove_child(parent, child_index(parent, leaf));
+		free_node(leaf);
+		rebalance_inner(parent);
+	}
+
+	// Restore the fill invariant of a leaf by merging it with a sibling or by moving entries over from the sibling.
+	// The right node of a merged pair is the one freed. position is kept pointing at the same entry.
+	void rebalance_leaf(leaf_node* leaf, iterator& position) {
+		inner_node* parent = leaf->parent;
+		if(!parent || leaf->count >= LeafSlots / 4 || parent->count == 0)
+			return;
+
+		std::size_t index = child_index(parent, leaf);
+		std::size_t separator = index > 0 ? index - 1 : 0;
+		leaf_node* left = static_cast<leaf_node*>(parent->children[separator]);
+		leaf_node* right = static_cast<leaf_node*>(parent->children[separator + 1]);
+		std::size_t total = left->count + right->count;
+
+		if(total <= LeafSlots * 3 / 4) {
+			if(position.m_leaf == right)
+				position = iterator(left, left->count + position.m_index);
+			move_entries(right, 0, left, left->count, right->count);
+			left->count = total;
+			right->count = 0;
+			left->next = right->next;
+			if(right->next)
+				right->next->prev = left;
+			else
+				m_last = left;
+			remove_child(parent, separator + 1);
+			free_node(right);
+			rebalance_inner(parent);
+			return;
+		}
+
+		std::size_t target = total / 2;
+		if(left->count < target) {
+			std::size_t n = target - left->count;
+			if(position.m_leaf == right)
+				position = position.m_index < n ? iterator(left, left->count + position.m_index) : iterator(right, position.m_index - n);
+			move_entries(right, 0, left, left->count, n);
+			shift_left(right->keys.data(), 0, n, right->count);
+			shift_left(right->values.data(), 0, n, right->count);
+			left->count += n;
+			right->count -= n;
+		}
+		else {
+			std::size_t n = left->count - target;
+			if(position.m_leaf == right)
+				position = iterator(right, position.m_index + n);
+			else if(position.m_leaf == left && position.m_index >= target)
+				position = iterator(right, position.m_index - target);
+			shift_right_by(right->keys.data(), n, right->count);
+			shift_right_by(right->values.data(), n, right->count);
+			move_entries(left, target, right, 0, n);
+			left->count -= n;
+			right->count += n;
+		}
+		parent->keys[separator] = right->keys[0];
+	}
+
+	static void move_entries(leaf_node* from, std::size_t from_index, leaf_node* to, std::size_t to_index, std::size_t n) {
+		assert(from_index + n <= LeafSlots && to_index + n <= LeafSlots);
+		for(std::size_t i = 0; i < n; ++i) {
+			relocate_slot(from->keys.data() + from_index + i, to->keys.data() + to_index + i);
+			relocate_slot(from->values.data() + from_index + i, to->values.data() + to_index + i);
+		}
+	}
+
+	// Move the objects in [0, count) n slots to the right.
+	template<class T>
+	static void shift_right_by(T* slots, std::size_t n, std::size_t count) {
+		for(std::size_t i = count; i > 0; --i)
+			relocate_slot(slots + i - 1, slots + i - 1 + n);
+	}
+
+	// Restore the fill invariant of an inner node the same way as for leaves, pulling the separator down on a merge
+	// and rotating entries through the parent otherwise. A root left with a single child is replaced by the child.
+	void rebalance_inner(inner_node* node) {
+		inner_node* parent = node->parent;
+		if(!parent) {
+			if(node->count == 0) {
+				m_root = node->children[0];
+				m_root->parent = nullptr;
+				free_node(node);
+			}
+			return;
+		}
+		if(node->count >= InnerSlots / 4 || parent->count == 0)
+			return;
+
+		std::size_t index = child_index(parent, node);
+		std::size_t separator = index > 0 ? index - 1 : 0;
+		inner_node* left = static_cast<inner_node*>(parent->children[separator]);
+		inner_node* right = static_cast<inner_node*>(parent->children[separator + 1]);
+
+		if(left->count + right->count + 1 <= InnerSlots * 3 / 4) {
+			::new(static_cast<void*>(left->keys.data() + left->count)) K(std::move(parent->keys[separator]));
+			for(std::size_t i = 0; i < right->count; ++i)
+				relocate_slot(right->keys.data() + i, left->keys.data() + left->count + 1 + i);
+			for(std::size_t i = 0; i <= right->count; ++i) {
+				left->children[left->count + 1 + i] = right->children[i];
+				right->children[i]->parent = left;
+			}
+			left->count += right->count + 1;
+			right->count = 0;
+			remove_child(parent, separator + 1);
+			free_node(right);
+			rebalance_inner(parent);
+			return;
+		}
+
+		while(left->count + 1 < right->count)
+			rotate_left(parent, separator, left, right);
+		while(right->count + 1 < left->count)
+			rotate_right(parent, separator, left, right);
+	}
+
+	// Move the first child of right to the end of left through the separator in the parent.
+	static void rotate_left(inner_node* parent, std::size_t separator, inner_node* left, inner_node* right) {
+		::new(static_cast<void*>(left->keys.data() + left->count)) K(std::move(parent->keys[separator]));
+		parent->keys[separator] = std::move(right->keys[0]);
+		left->children[left->count + 1] = right->children[0];
+		right->children[0]->parent = left;
+		++left->count;
+
+		right->keys[0].~K();
+		shift_left(right->keys.data(), 0, 1, right->count);
+		std::copy(right->children + 1, right->children + right->count + 1, right->children);
+		--right->count;
+	}
+
+	// Move the last child of left to the front of right through the separator in the parent.
+	static void rotate_right(inner_node* parent, std::size_t separator, inner_node* left, inner_node* right) {
+		shift_right(right->keys.data(), 0, right->count);
+		std::copy_backward(right->children, right->children + right->count + 1, right->children + right->count + 2);
+		::new(static_cast<void*>(right->keys.data())) K(std::move(parent->keys[separator]));
+		right->children[0] = left->children[left->count];
+		right->children[0]->parent = right;
+		++right->count;
+
+		parent->keys[separator] = std::move(left->keys[left->count - 1]);
+		left->keys[left->count - 1].~K();
+		--left->count;
+	}
+};
+
+struct map_storage {
+	template<class K, class V, class Allocator = std::allocator<std::pair<const K,V>>>
+	using container = std::map<K,V,std::less<K>,Allocator>;
+
+	// The node of the item is extracted, given the new key and inserted again, so its memory and its value are reused.
+	// Before C++17 std::map has no node handles, then the value is moved into a new node.
+	// Complexity: amortized constant
+	template<class Map, class K>
+	static typename Map::iterator replace_key( Map& map, typename Map::iterator it, K const& key ) {
+		auto next = std::next(it);
+#if defined(__cpp_lib_node_extract)
+		auto node = map.extract(it);
+		node.key() = key;
+		return map.insert(next, std::move(node));
+#else
+		auto val = std::move(it->second);
+		map.erase(it);
+		return map.emplace_hint(next, key, std::move(val));
+#endif
+	}
+};
+
+// The default node sizes keep the key array of a leaf within a few cache lines for word sized keys.
+template<std::size_t LeafSlots = 64, std::size_t InnerSlots = 64>
+struct btree_storage {
+	template<class K, class V, class Allocator = std::allocator<std::pair<const K,V>>>
+	using container = btree_map<K,V,LeafSlots,InnerSlots,Allocator>;
+
+	template<class Map, class K>
+	static typename Map::iterator replace_key( Map& map, typename Map::iterator it, K const& key ) {
+		return map.replace_key(it, key);
+	}
+};
+
+// Memory resources for the boundaries of an interval_map.
+// interval_map takes an Allocator template parameter, which the storage rebinds to its node types. Besides any standard
+// allocator (e.g. std::pmr::polymorphic_allocator, see pmr::interval_map below), the following resources can be used
+// through resource_allocator, so that assign does not call the system allocator for every boundary:
+// - node_pool recycles the memory of erased boundaries for new ones.
+// - monotonic_arena never frees single boundaries, but releases a whole map at once.
+// - counting_resource takes memory from the system allocator, counting the allocations and the bytes held.
+
+// Pool of fixed size blocks. Memory is requested from the system in chunks of blocks, and blocks given back are put on a
+// free list, from which they are handed out again. Blocks of every distinct size have their own free list, a std::map
+// allocates a single size (its node), a B+-tree two (its leaves and inner nodes).
+// All memory is returned to the system when the pool is destroyed. The pool is not thread safe.
+class node_pool {
+private:
+	struct free_block {
+		free_block* next;
+	};
+
+	struct size_class {
+		std::size_t size;
+		free_block* free;
+	};
+
+	std::size_t m_blocks_per_chunk;
+	std::vector<size_class> m_classes;
+	std::vector<void*> m_chunks;
+
+public:
+	explicit node_pool( std::size_t blocks_per_chunk = 1024 ) : m_blocks_per_chunk(blocks_per_chunk) {}
+
+	node_pool( node_pool const& ) = delete;
+	node_pool& operator=( node_pool const& ) = delete;
+
+	~node_pool() {
+		for(void* chunk : m_chunks)
+			::operator delete(chunk);
+	}
+
+	// Blocks are aligned like the chunks, i.e. for any fundamental type.
+	void* allocate( std::size_t size, std::size_t alignment ) {
+		assert(alignment <= alignof(std::max_align_t));
+		static_cast<void>(alignment); // unused if assert is compiled out
+		size_class& c = find_class(size);
+		if(!c.free)
+			add_chunk(c);
+		free_block* block = c.free;
+		c.free = block->next;
+		return block;
+	}
+
+	void deallocate( void* p, std::size_t size, std::size_t ) {
+		size_class& c = find_class(size);
+		free_block* block = static_cast<free_block*>(p);
+		block->next = c.free;
+		c.free = block;
+	}
+
+	// number of chunks requested from the system so far
+	std::size_t chunk_count() const {
+		return m_chunks.size();
+	}
+
+private:
+	size_class& find_class( std::size_t size ) {
+		// Round the size up so that every block of the class stays aligned and can hold a free list link.
+		std::size_t const unit = alignof(std::max_align_t);
+		size = (std::max(size, sizeof(free_block)) + unit - 1) / unit * unit;
+		for(size_class& c : m_classes) {
+			if(c.size == size)
+				return c;
+		}
+		m_classes.push_back(size_class{size, nullptr});
+		return m_classes.back();
+	}
+
+	void add_chunk( size_class& c ) {
+		char* chunk = static_cast<char*>(::operator new(c.size * m_blocks_per_chunk));
+		m_chunks.push_back(chunk);
+		for(std::size_t i = m_blocks_per_chunk; i > 0; --i) {
+			free_block* block = reinterpret_cast<free_block*>(chunk + (i - 1) * c.size);
+			block->next = c.free;
+			c.free = block;
+		}
+	}
+};
+
+// Arena handing out memory by bumping a pointer through chunks of doubling size. Memory given back is not reused;
+// everything is returned to the system at once when the arena is destroyed, in time proportional to the number of
+// chunks, which grows only logarithmically with the memory used. The arena is not thread safe.
+class monotonic_arena {
+private:
+	std::vector<void*> m_chunks;
+	char* m_current;
+	std::size_t m_left;
+	std::size_t m_next_chunk_size;
+
+public:
+	explicit monotonic_arena( std::size_t initial_chunk_size = 64 * 1024 )
+		: m_current(nullptr), m_left(0), m_next_chunk_size(initial_chunk_size) {}
+
+	monotonic_arena( monotonic_arena const& ) = delete;
+	monotonic_arena& operator=( monotonic_arena const& ) = delete;
+
+	~monotonic_arena() {
+		for(void* chunk : m_chunks)
+			::operator delete(chunk);
+	}
+
+	void* allocate( std::size_t size, std::size_t alignment ) {
+		assert(alignment <= alignof(std::max_align_t));
+		std::size_t padding = (alignment - reinterpret_cast<std::uintptr_t>(m_current) % alignment) % alignment;
+		if(m_left < padding + size) {
+			std::size_t chunk_size = std::max(m_next_chunk_size, size);
+			m_current = static_cast<char*>(::operator new(chunk_size));
+			m_chunks.push_back(m_current);
+			m_left = chunk_size;
+			m_next_chunk_size *= 2;
+			padding = 0;
+		}
+		void* p = m_current + padding;
+		m_current += padding + size;
+		m_left -= padding + size;
+		return p;
+	}
+
+	void deallocate( void*, std::size_t, std::size_t ) {}
+
+	// Construct an object in the arena which is never destroyed, it is dropped together with the arena instead.
+	// This is correct as long as the destructor would do nothing but give memory back to the arena, e.g. for an
+	// interval_map allocating from this arena with trivially destructible K and V. Dropping such a map then takes no
+	// time per boundary.
+	template<class T, class... Args>
+	T* make( Args&&... args ) {
+		return ::new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+};
+
+// Allocator handing out memory from a resource such as node_pool or monotonic_arena, which has to outlive every
+// container using it.
+template<class T, class Resource>
+class resource_allocator {
+	template<class, class> friend class resource_allocator;
+
+private:
+	Resource* m_resource;
+
+public:
+	typedef T value_type;
+
+	resource_allocator( Resource& resource ) : m_resource(&resource) {}
+
+	template<class U>
+	resource_allocator( resource_allocator<U,Resource> const& other ) : m_resource(other.m_resource) {}
+
+	T* allocate( std::size_t n ) {
+		return static_cast<T*>(m_resource->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate( T* p, std::size_t n ) {
+		m_resource->deallocate(p, n * sizeof(T), alignof(T));
+	}
+
+	template<class U>
+	bool operator==( resource_allocator<U,Resource> const& other ) const {
+		return m_resource == other.m_resource;
+	}
+
+	template<class U>
+	bool operator!=( resource_allocator<U,Resource> const& other ) const {
+		return m_resource != other.m_resource;
+	}
+};
+
+// Resource passing every allocation on to the system allocator, counting the allocations and the bytes held.
+class counting_resource {
+private:
+	std::size_t m_allocations;
+	std::size_t m_current;
+	std::size_t m_peak;
+
+public:
+	counting_resource() : m_allocations(0), m_current(0), m_peak(0) {}
+
+	void* allocate( std::size_t size, std::size_t alignment ) {
+		assert(alignment <= alignof(std::max_align_t));
+		static_cast<void>(alignment); // unused if assert is compiled out
+		++m_allocations;
+		m_current += size;
+		m_peak = std::max(m_peak, m_current);
+		return ::operator new(size);
+	}
+
+	void deallocate( void* p, std::size_t size, std::size_t ) {
+		m_current -= size;
+		::operator delete(p);
+	}
+
+	// number of allocations so far
+	std::size_t allocations() const {
+		return m_allocations;
+	}
+
+	// bytes currently allocated
+	std::size_t current() const {
+		return m_current;
+	}
+
+	// most bytes allocated at once so far
+	std::size_t peak() const {
+		return m_peak;
+	}
+};
+
+// Instrumentation.
+// The cost of assign and operator[] is bounded in the operations on K and V and in the searches from scratch (see the
+// comments of assign). Two means are provided to verify the bounds:
+// - counted<T> wraps a key or value type, counting the copies, moves and comparisons of its objects,
+// - if INTERVAL_MAP_COUNTERS is defined before this file is included, every interval_map counts its searches from
+//   scratch, its insertions (each allocating a node of a std::map) and its erase calls in interval_map_counters.
+
+// Operations on the objects of a counted<T> type.
+struct operation_counts {
+	std::size_t copies = 0;      // copy constructions and copy assignments
+	std::size_t moves = 0;       // move constructions and move assignments
+	std::size_t comparisons = 0; // calls of operator< and operator==
+};
+
+// Value of type T which counts the operations on it in counts(), shared by all objects of counted<T>. Counting is not
+// thread safe. counted<T> is less-than and equality comparable and std::numeric_limits<counted<T>> gives the limits
+// of T, so it can be used for K and V of interval_map.
+template<class T>
+class counted {
+private:
+	T m_value;
+
+public:
+	explicit counted( T const& value ) : m_value(value) {}
+
+	counted( counted const& other ) : m_value(other.m_value) {
+		++counts().copies;
+	}
+
+	counted( counted&& other ) : m_value(std::move(other.m_value)) {
+		++counts().moves;
+	}
+
+	counted& operator=( counted const& other ) {
+		++counts().copies;
+		m_value = other.m_value;
+		return *this;
+	}
+
+	counted& operator=( counted&& other ) {
+		++counts().moves;
+		m_value = std::move(other.m_value);
+		return *this;
+	}
+
+	T const& value() const {
+		return m_value;
+	}
+
+	friend bool operator<( counted const& a, counted const& b ) {
+		++counts().comparisons;
+		return a.m_value < b.m_value;
+	}
+
+	friend bool operator==( counted const& a, counted const& b ) {
+		++counts().comparisons;
+		return a.m_value == b.m_value;
+	}
+
+	static operation_counts& counts() {
+		static operation_counts c;
+		return c;
+	}
+};
+
+namespace std {
+	template<class T>
+	struct numeric_limits<counted<T>> : numeric_limits<T> {
+		static counted<T> min() { return counted<T>(numeric_limits<T>::min()); }
+		static counted<T> max() { return counted<T>(numeric_limits<T>::max()); }
+		static counted<T> lowest() { return counted<T>(numeric_limits<T>::lowest()); }
+	};
+}
+
+// Operations of an interval_map, counted if INTERVAL_MAP_COUNTERS is defined.
+struct interval_map_counters {
+	std::size_t searches = 0;      // searches from scratch, i.e. calls of lower_bound and upper_bound of the storage
+	std::size_t insertions = 0;    // boundaries inserted
+	std::size_t key_replacements = 0; // boundaries moved to another key, reusing their node and value
+	std::size_t erased_ranges = 0; // calls of erase of the storage, each erasing a possibly empty range of boundaries
+};
+
+#if defined(INTERVAL_MAP_COUNTERS)
+#define INTERVAL_MAP_COUNT(counter) (++m_counters.counter)
+#else
+#define INTERVAL_MAP_COUNT(counter) static_cast<void>(0)
+#endif
+
+// Value associated with the interval of keys from begin (including) to end (excluding).
+template<class K, class V>
+struct interval {
+	K begin;
+	K end;
+	V value;
+};
+
+template<class K, class V, class Storage = map_storage, class Allocator = std::allocator<std::pair<const K,V>>>
+class interval_map {
+	friend void IntervalMapTest();
+	template<class, class, class, class> friend class interval_map;
+	template<class, class> friend class frozen_interval_map;
+	template<class, class> friend class mapped_interval_map;
+	
+private:	
+	typename Storage::template container<K,V,Allocator> m_map;
+	std::size_t m_version = 0; // incremented by every change of m_map, so that cursors can tell whether they are stale
+#if defined(INTERVAL_MAP_COUNTERS)
+	mutable interval_map_counters m_counters;
+#endif
+
+public:
+	class cursor;
+
+	// constructor associates whole range of K with val by inserting (K_min, val) into the map
+	// The boundaries are allocated through alloc.
+	interval_map( V const& val, Allocator const& alloc = Allocator()) : m_map(alloc) {
+		emplace(m_map.begin(),std::numeric_limits<K>::min(),val);
+	};
+
+	// Assign value val to interval [keyBegin, keyEnd). 
+	// Overwrite previous values in this interval. Do not change values outside this interval.
+	// Conforming to the C++ Standard Library conventions, the interval includes keyBegin, but excludes keyEnd.
+	// If !( keyBegin < keyEnd ), this designates an empty interval, and assign must do nothing.
+	void assign( K const& keyBegin, K const& keyEnd, const V& val ) {
+		// TODO:
+		// Implement this function.
+		// Your implementation is graded by these criteria in this order:
+		// - correctness (of course): In particular, pay attention to the validity of iterators. It is illegal to dereference
+		//   end iterators. Consider using a checking STL implementation such as the one shipped with Visual C++.
+		// - simplicity: simple code is easy to understand and maintain, which is important in large projects. 
+		//   To write a simple solution, you need to exploit the structure of the problem.
+		//   Use functions of std::map wherever you can.
+		// - running time: Imagine your implementation is part of a library, so it should be big-O optimal.
+		//   In addition, 
+		//   * do not make big-O more operations on K and V than necessary, because you 
+		//     do not know how fast operations on K/V are; remember that constructions, destructions and assignments 
+		//     are operations as well.
+		//   * do not make more than two operations of amortized O(log N), in contrast to O(1), running time, where N is the number of elements in m_map.
+		//     Any operation that needs to find a position in the map "from scratch", without being given a nearby position, is such an operation.
+		//   Otherwise favor simplicity over minor speed improvements.
+		// - time to turn in the solution: you should not take longer than a day, and you may be faster.
+		//   But don't rush, I would not give you this assignment if it were trivial.
+		//
+		// You must develop the solution yourself. You may not let others help you or search for existing solutions. Of course
+		// you may use any documentation of the C++ language or the C++ Standard Library.
+		// Do not give your solution to others or make it public. It will entice others into
+		// sending in plagiarized solutions.
+
+
+		// Assign only if the interval boundaries are valid.
+		if(keyBegin < keyEnd) {
+			// Find map item with key greater or equal to the new interval's upper boundary.
+			// This is the only search from scratch, the rest of the work is done by assign_before().
+			// Complexity: logarithmic
+			assign_before(lower_bound(keyEnd),keyBegin,keyEnd,val);
+		}
+	}
+
+	// Like the above, but val is moved into the map instead of being copied.
+	// The value of the interval containing keyEnd is copied only if that interval also contains keyBegin, i.e. if it is
+	// split in two, so that this assign copies V at most once.
+	void assign( K const& keyBegin, K const& keyEnd, V&& val ) {
+		if(keyBegin < keyEnd)
+			assign_before(lower_bound(keyEnd),keyBegin,keyEnd,std::move(val));
+	}
+
+	// Assign a sequence of intervals, each given as an object with begin, end and value members, e.g. interval<K,V>.
+	// The result is the same as calling assign() for every interval in order, including the handling of empty intervals.
+	// The map is traversed in a single sweep: every interval continues from the position where the previous one
+	// ended, walking forward over a few map items before falling back to a search.
+	// Thus, if the intervals are sorted by their keys and do not overlap, a run of intervals which are close to each other
+	// costs amortized O(1) per interval plus the number of items erased, and no interval costs more than O(log N).
+	// Intervals in any other order are still assigned correctly, each of them then costs a search.
+	template<class InputIt>
+	void assign_sorted(InputIt first, InputIt last) {
+		auto it = std::begin(m_map);
+		for(; first != last; ++first) {
+			auto const& item = *first;
+			if(item.begin < item.end)
+				it = assign_before(seek(it,item.end),item.begin,item.end,item.value);
+		}
+	}
+
+	// Replace the contents of the map by f(a[key], b[key]) for every key, which has to be convertible to V.
+	// The boundaries of a and b are walked together in ascending order, every boundary of either map is a candidate
+	// boundary of the result, which is kept only if f gives a value different from the one for the preceding boundary.
+	// The result is built in a new storage, appending every boundary with a hint at its end, and swapped in at the end,
+	// so a and b may be the map itself.
+	// Complexity: O(N + M) where N and M are the numbers of boundaries of a and b, without any search from scratch;
+	// f is called once per boundary of a and of b, boundaries at the same key counting once
+	template<class VA, class SA, class AA, class VB, class SB, class AB, class Function>
+	void assign_combined( interval_map<K,VA,SA,AA> const& a, interval_map<K,VB,SB,AB> const& b, Function f ) {
+		auto a_it = std::begin(a.m_map), b_it = std::begin(b.m_map);
+		auto const a_end = std::end(a.m_map);
+		auto const b_end = std::end(b.m_map);
+		// Both maps begin at the lowest value of K. a_value and b_value are the items whose intervals contain the
+		// key of the boundary being combined.
+		auto a_value = a_it++, b_value = b_it++;
+		map_type combined(m_map.get_allocator());
+		INTERVAL_MAP_COUNT(insertions);
+		auto last = combined.emplace_hint(std::end(combined),a_value->first,f(a_value->second,b_value->second));
+		while(a_it != a_end || b_it != b_end) {
+			K const* key;
+			if(b_it == b_end || (a_it != a_end && a_it->first < b_it->first)) {
+				key = &a_it->first;
+				a_value = a_it++;
+			}
+			else if(a_it == a_end || b_it->first < a_it->first) {
+				key = &b_it->first;
+				b_value = b_it++;
+			}
+			else {
+				key = &a_it->first;
+				a_value = a_it++;
+				b_value = b_it++;
+			}
+			V value = f(a_value->second,b_value->second);
+			if(!(last->second == value)) {
+				// Complexity: amortized constant, as the boundary is inserted at the end
+				INTERVAL_MAP_COUNT(insertions);
+				last = combined.emplace_hint(std::end(combined),*key,std::move(value));
+			}
+		}
+		m_map.swap(combined);
+		++m_version;
+	}
+
+	// Assign the intervals of other whose value is not transparent, leaving the map unchanged where other holds
+	// transparent. The result is the same as calling assign() for every such interval of other, except that the last
+	// interval of other also covers the highest value of K, which assign() cannot express.
+	// Complexity: O(N + M), see assign_combined()
+	template<class S, class A>
+	void overlay( interval_map<K,V,S,A> const& other, V const& transparent ) {
+		assign_combined(*this, other, [&transparent](V const& below, V const& above) -> V const& {
+			return above == transparent ? below : above;
+		});
+	}
+
+	// Replace the contents of the map by the boundaries [first, last), objects with begin and value members, which have
+	// to form a canonical map: the first one begins at the lowest value of K, they are in ascending order of begin and
+	// consecutive values differ. Like in assign_combined(), every boundary is appended with a hint at the end of a new
+	// storage, which is swapped in at the end.
+	// Complexity: O(M) for M boundaries, without any search from scratch or comparison of values
+	template<class InputIt>
+	void assign_boundaries( InputIt first, InputIt last ) {
+		map_type boundaries(m_map.get_allocator());
+		for(; first != last; ++first) {
+			INTERVAL_MAP_COUNT(insertions);
+			boundaries.emplace_hint(std::end(boundaries),first->begin,first->value);
+		}
+		m_map.swap(boundaries);
+		++m_version;
+	}
+
+	// look-up of the value associated with key
+	V const& operator[]( K const& key ) const {
+		return ( --upper_bound(key) )->second;
+	}
+
+	// Call visitor(begin, end, value) for every interval of the map overlapping [keyBegin, keyEnd), in ascending order,
+	// with the interval clipped to [keyBegin, keyEnd). The intervals passed are contiguous: the first one begins at
+	// keyBegin, every next one at the end of the previous one, and the last one ends at keyEnd, also when it is the
+	// last interval of the map, which has no explicit upper boundary. Consecutive intervals have different values.
+	// If !( keyBegin < keyEnd ), visitor is not called. The map must not be modified by visitor.
+	// Complexity: logarithmic plus O(k) where k is the number of intervals passed, without any allocation
+	template<class Visitor>
+	void for_each_interval( K const& keyBegin, K const& keyEnd, Visitor visitor ) const {
+		if(!(keyBegin < keyEnd))
+			return;
+		// Find the map item of the interval containing keyBegin. Every interval ends where the next item begins.
+		auto it = --upper_bound(keyBegin);
+		K const* begin = &keyBegin;
+		for(auto next = std::next(it); next != std::end(m_map) && next->first < keyEnd; ++next) {
+			visitor(*begin, next->first, it->second);
+			begin = &next->first;
+			it = next;
+		}
+		visitor(*begin, keyEnd, it->second);
+	}
+
+	// Batch look-up of the values associated with a sequence of keys, writing a pointer to each value to out.
+	// The keys are resolved in a single sweep like in assign_sorted(): every key continues from the map item found for
+	// the previous one, walking forward over a few items before falling back to a search.
+	// Thus ascending keys which are close to each other cost amortized O(1) each instead of a search from the root.
+	// A key lower than its predecessor is searched for from scratch.
+	// Returns the output iterator past the last pointer written.
+	template<class InputIt, class OutputIt>
+	OutputIt lookup( InputIt first, InputIt last, OutputIt out ) const {
+		auto it = std::begin(m_map);
+		for(; first != last; ++first) {
+			it = seek_upper(it,*first);
+			*out = &std::prev(it)->second;
+			++out;
+		}
+		return out;
+	}
+
+	// number of boundaries, i.e. of the intervals the whole range of K is divided into
+	std::size_t size() const {
+		return m_map.size();
+	}
+
+	// Make a cursor for look-ups and assigns of keys close to each other, see cursor.
+	cursor get_cursor() {
+		return cursor(*this);
+	}
+
+#if defined(INTERVAL_MAP_COUNTERS)
+	// operations counted since construction or the last reset_counters()
+	interval_map_counters const& counters() const {
+		return m_counters;
+	}
+
+	void reset_counters() {
+		m_counters = interval_map_counters();
+	}
+#endif
+private:
+	typedef typename Storage::template container<K,V,Allocator> map_type;
+	typedef typename map_type::iterator map_iterator;
+
+	// Assign value val to the non-empty interval [keyBegin, keyEnd), given the map item with key greater or equal to keyEnd.
+	// Returns an iterator to a map item not past the first one with key greater or equal to keyEnd, which can be used
+	// to continue a sweep over the map.
+	// The storage may invalidate iterators on insert and erase (e.g. a B+-tree moves entries between nodes), hence
+	// every iterator used after the map has been restructured is one returned by insert() or erase().
+	// val is forwarded into the map once, every other value stored is either kept in its item or copied once.
+	// Items which the new interval overwrites are reused for its boundaries where possible, keeping their nodes.
+	template<class Val>
+	map_iterator assign_before( map_iterator erase_end_it, K const& keyBegin, K const& keyEnd, Val&& val ) {
+		++m_version;
+		// If found item's key is equal to the new interval's upper boundary these intervals are contiguous,
+		// otherwise the value of the previous map item has to be preserved from the new interval's upper boundary on,
+		// so that values outside of the new interval will not be changed.
+		// In this if statement the iterator can be safely dereferenced, because if the second condition is reached that means
+		// the first condition was not satisfied, thus the iterator does not point to the after-the-last item in the map.
+		if(erase_end_it == std::end(m_map) || keyEnd < erase_end_it->first) {
+			auto end_previous_it = std::prev(erase_end_it);
+			// If the previous item has the same value as the new interval, the new interval simply extends it up to
+			// the next item, so no upper boundary is needed. Otherwise the value of the previous item has to start at
+			// keyEnd. If the previous item falls into the new interval, it would be erased, so it is moved to keyEnd
+			// with its value instead. Otherwise its interval is split in two and a new map item is created with a copy
+			// of its value. Knowing that the new item is directly preceding the next item, iterator to the next item
+			// can be provided as a parameter to emplace(), thus:
+			// Complexity: amortized constant
+			if(!(end_previous_it->second == val)) {
+				if(!(end_previous_it->first < keyBegin))
+					erase_end_it = replace_key(end_previous_it,keyEnd);
+				else
+					erase_end_it = emplace(erase_end_it,keyEnd,end_previous_it->second);
+			}
+		}
+		else if(erase_end_it->second == val) {
+			// If the value of the next interval is the same as the new interval's value, the lower boundary
+			// of the next interval should be erased from the map.
+			++erase_end_it;
+		}
+
+		// Walk back to the first map item falling into the new interval. All items from there up to erase_end_it
+		// (excluding) have to be erased to overwrite previous values in this interval, so walking over them
+		// costs no more than erasing them and a second search from scratch is not needed.
+		// Complexity: O(N) where N is the number of items erased
+		auto erase_begin_it = erase_end_it;
+		while(erase_begin_it != std::begin(m_map)) {
+			auto previous_it = std::prev(erase_begin_it);
+			if(previous_it->first < keyBegin)
+				break;
+			erase_begin_it = previous_it;
+		}
+
+		// Now the value of the new interval has to be compared to the value of the preceding interval.
+		// If they are equal the lower boundary of the new interval should not be stored in the map.
+		// The first condition makes sure there is a preceding item, i.e. keyBegin is not the lowest value of K.
+		if(erase_begin_it != std::begin(m_map) && std::prev(erase_begin_it)->second == val) {
+			// Complexity: amortized O(N) where N is the number of items erased
+			return erase(erase_begin_it,erase_end_it);
+		}
+		// If any map item falls into the new interval, reuse the first one for the lower boundary instead of erasing it
+		// and inserting a new one, moving it to keyBegin unless it is there already. erase_begin_it can be dereferenced,
+		// as it precedes erase_end_it.
+		if(erase_begin_it != erase_end_it) {
+			if(keyBegin < erase_begin_it->first)
+				erase_begin_it = replace_key(erase_begin_it,keyBegin);
+			erase_begin_it->second = std::forward<Val>(val);
+			return erase(std::next(erase_begin_it),erase_end_it);
+		}
+		// Otherwise the lower boundary is inserted directly before erase_end_it.
+		// Complexity: amortized constant
+		return emplace(erase_end_it,keyBegin,std::forward<Val>(val));
+	}
+
+	// The storage is searched and modified only through these functions, which count the calls.
+	map_iterator lower_bound( K const& key ) {
+		INTERVAL_MAP_COUNT(searches);
+		return m_map.lower_bound(key);
+	}
+
+	typename map_type::const_iterator upper_bound( K const& key ) const {
+		INTERVAL_MAP_COUNT(searches);
+		return m_map.upper_bound(key);
+	}
+
+	template<class Val>
+	map_iterator emplace( map_iterator hint, K const& key, Val&& val ) {
+		INTERVAL_MAP_COUNT(insertions);
+		return m_map.emplace_hint(hint,key,std::forward<Val>(val));
+	}
+
+	map_iterator replace_key( map_iterator it, K const& key ) {
+		INTERVAL_MAP_COUNT(key_replacements);
+		return Storage::replace_key(m_map,it,key);
+	}
+
+	map_iterator erase( map_iterator first, map_iterator last ) {
+		INTERVAL_MAP_COUNT(erased_ranges);
+		return m_map.erase(first,last);
+	}
+
+	// Maximum number of map items walked over by seek() and seek_upper() before searching from scratch.
+	// Each step may be a cache miss, so a walk longer than a few items costs more than a search.
+	static const std::size_t seek_steps = 4;
+
+	// Advance it to the first map item with key greater or equal to key. Up to seek_steps items are walked over,
+	// if the item is further away, or if it precedes it, it is searched for from scratch. The item right before it is
+	// found without a search if its key is key.
+	map_iterator seek( map_iterator it, K const& key ) {
+		if(it != std::begin(m_map)) {
+			auto previous_it = std::prev(it);
+			if(!(previous_it->first < key))
+				return key < previous_it->first ? lower_bound(key) : previous_it;
+		}
+		for(std::size_t steps = 0; steps < seek_steps; ++steps) {
+			if(it == std::end(m_map) || !(it->first < key))
+				return it;
+			++it;
+		}
+		return lower_bound(key);
+	}
+
+	// Advance it to the first map item with key greater than key, the same way as seek() does.
+	typename map_type::const_iterator seek_upper( typename map_type::const_iterator it, K const& key ) const {
+		if(it != std::begin(m_map) && key < std::prev(it)->first)
+			return upper_bound(key);
+		for(std::size_t steps = 0; steps < seek_steps; ++steps) {
+			if(it == std::end(m_map) || key < it->first)
+				return it;
+			++it;
+		}
+		return upper_bound(key);
+	}
+};
+
+// Position in an interval_map remembered between look-ups and assigns, for keys which are mostly ascending and close to
+// each other, e.g. timestamps or sequential addresses. Every call continues from the map item found by the previous
+// one, the same way as assign_sorted() and lookup() do: a key in the same interval as the previous one costs a constant
+// number of comparisons, one up to seek_steps boundaries further costs that many steps, and any other key, including a
+// lower one, is searched for from scratch.
+// An assign through the cursor keeps it valid. Any other change of the map, e.g. an assign through the map or another
+// cursor, makes it stale, which valid() tells. A stale cursor is still safe to use, its next call searches from
+// scratch. Like an iterator, a cursor must not be used after its map is destroyed or assigned to.
+template<class K, class V, class Storage, class Allocator>
+class interval_map<K,V,Storage,Allocator>::cursor {
+	friend class interval_map;
+
+	interval_map* m_owner;
+	map_iterator m_it; // the first map item with key greater or equal to the key of the previous call
+	std::size_t m_version; // version of the map m_it belongs to
+
+	explicit cursor( interval_map& owner ) : m_owner(&owner), m_it(std::begin(owner.m_map)), m_version(owner.m_version) {}
+
+public:
+	// look-up of the value associated with key
+	// Complexity: constant within the interval of the previous key, logarithmic at worst
+	V const& operator[]( K const& key ) {
+		m_it = m_owner->seek(position(),key);
+		// The interval containing key begins at the item found if its key is key, otherwise at the item before it.
+		if(m_it != std::end(m_owner->m_map) && !(key < m_it->first))
+			return m_it->second;
+		return std::prev(m_it)->second;
+	}
+
+	// Assign value val to interval [keyBegin, keyEnd), with the same semantics as interval_map::assign.
+	// The interval is found starting from the previous position instead of searching for keyEnd from scratch.
+	void assign( K const& keyBegin, K const& keyEnd, V const& val ) {
+		if(keyBegin < keyEnd)
+			advance(m_owner->assign_before(m_owner->seek(position(),keyEnd),keyBegin,keyEnd,val));
+	}
+
+	void assign( K const& keyBegin, K const& keyEnd, V&& val ) {
+		if(keyBegin < keyEnd)
+			advance(m_owner->assign_before(m_owner->seek(position(),keyEnd),keyBegin,keyEnd,std::move(val)));
+	}
+
+	// Whether the map has been changed other than through this cursor since its last call.
+	bool valid() const {
+		return m_version == m_owner->m_version;
+	}
+
+private:
+	// The remembered position, or the first item of the map if the cursor is stale.
+	map_iterator position() {
+		if(!valid()) {
+			m_it = std::begin(m_owner->m_map);
+			m_version = m_owner->m_version;
+		}
+		return m_it;
+	}
+
+	void advance( map_iterator it ) {
+		m_it = it;
+		m_version = m_owner->m_version;
+	}
+};
+
+// interval_map holding f(a[key], b[key]) for every key, in the storage of a, see interval_map::assign_combined().
+// The boundaries are allocated with the default allocator, use assign_combined() to combine into a map with another one.
+// Complexity: O(N + M) where N and M are the numbers of boundaries of a and b
+template<class K, class VA, class SA, class AA, class VB, class SB, class AB, class Function>
+interval_map<K,typename std::decay<decltype(std::declval<Function&>()(std::declval<VA const&>(), std::declval<VB const&>()))>::type,SA>
+combine( interval_map<K,VA,SA,AA> const& a, interval_map<K,VB,SB,AB> const& b, Function f ) {
+	typedef typename std::decay<decltype(f(std::declval<VA const&>(), std::declval<VB const&>()))>::type value_type;
+	K const& lowest = std::numeric_limits<K>::min();
+	interval_map<K,value_type,SA> result(f(a[lowest], b[lowest]));
+	result.assign_combined(a, b, f);
+	return result;
+}
+
+#if defined(__cpp_lib_memory_resource)
+// interval_map allocating its boundaries from a std::pmr::memory_resource, e.g. std::pmr::unsynchronized_pool_resource
+// or std::pmr::monotonic_buffer_resource, which is passed to the constructor.
+namespace pmr {
+	template<class K, class V, class Storage = map_storage>
+	using interval_map = ::interval_map<K,V,Storage,std::pmr::polymorphic_allocator<std::pair<const K,V>>>;
+}
+#endif
+
+// Number of trailing zero bits of a non-zero value.
+inline unsigned trailing_zeros(std::size_t x) {
+#if defined(__GNUC__)
+	return __builtin_ctzll(x);
+#else
+	unsigned n = 0;
+	for(; !(x & 1); x >>= 1)
+		++n;
+	return n;
+#endif
+}
+
+// frozen_interval_map<K,V> is an immutable, read-optimised copy of an interval_map.
+// The boundaries are stored in Eytzinger (breadth-first) order: the boundary at index k (counting from 1) has its
+// children at 2k and 2k+1, as in a binary heap. Keys and values are kept in two parallel arrays, so memory per
+// boundary is sizeof(K) + sizeof(V), without the per node pointers and allocation overhead of the mutable map.
+// A look-up descends from index 1 without any data dependent branch, and the first levels of the tree, which every
+// look-up visits, share a few cache lines. The descent prefetches the keys four levels ahead, which for word sized
+// keys are 16 consecutive elements.
+template<class K, class V>
+class frozen_interval_map {
+private:
+	// A value wrapped in a struct, so that the array of values is never the packed std::vector<bool>, whose elements
+	// cannot be returned by reference.
+	struct value_slot {
+		V value;
+	};
+
+	std::vector<K> m_keys;
+	std::vector<value_slot> m_values;
+
+public:
+	// Copy the boundaries of an interval_map.
+	// Complexity: O(N)
+	template<class Storage, class Allocator>
+	explicit frozen_interval_map( interval_map<K,V,Storage,Allocator> const& map ) {
+		// Collect the boundaries in sorted order, then emit them in breadth-first order of the implicit tree.
+		std::vector<decltype(std::begin(map.m_map))> sorted;
+		sorted.reserve(map.m_map.size());
+		for(auto it = std::begin(map.m_map); it != std::end(map.m_map); ++it)
+			sorted.push_back(it);
+
+		std::vector<std::size_t> rank(sorted.size() + 1);
+		std::size_t next_rank = 0;
+		assign_ranks(rank, 1, next_rank);
+
+		m_keys.reserve(sorted.size());
+		m_values.reserve(sorted.size());
+		for(std::size_t k = 1; k <= sorted.size(); ++k) {
+			m_keys.push_back(sorted[rank[k]]->first);
+			m_values.push_back(value_slot{sorted[rank[k]]->second});
+		}
+	}
+
+	// look-up of the value associated with key
+	V const& operator[]( K const& key ) const {
+		std::size_t const n = m_keys.size();
+		// Go right whenever the key at k is not greater than key. At the end k holds the path taken, one bit per level.
+		std::size_t k = 1;
+		while(k <= n) {
+#if defined(__GNUC__)
+			__builtin_prefetch(m_keys.data() + std::min(16 * k, n) - 1);
+#endif
+			k = 2 * k + !(key < m_keys[k - 1]);
+		}
+		// The boundary of the interval containing key is the last one where the descent went right. It is never missing,
+		// because the lowest boundary is the lowest value of K. Strip the trailing left turns and that right turn.
+		k >>= trailing_zeros(k) + 1;
+		return m_values[k - 1].value;
+	}
+
+	// number of boundaries
+	std::size_t size() const {
+		return m_keys.size();
+	}
+
+private:
+	// In-order traversal of the implicit tree, giving every index k the rank of the boundary stored there.
+	void assign_ranks( std::vector<std::size_t>& rank, std::size_t k, std::size_t& next_rank ) const {
+		if(k < rank.size()) {
+			assign_ranks(rank, 2 * k, next_rank);
+			rank[k] = next_rank++;
+			assign_ranks(rank, 2 * k + 1, next_rank);
+		}
+	}
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+// mapped_interval_map<K,V> serves look-ups from an interval_map saved to a file, which is mapped into memory instead of
+// being read, so that opening it takes no parsing, no copying and no allocation, and only the pages look-ups touch are
+// loaded from disk. K and V have to be trivially copyable, as they are stored by their bytes.
+//
+// The file consists of
+// - a header: magic, format version, byte order mark, sizeof(K), sizeof(V) and the number of boundaries N,
+// - the N boundary keys in ascending order, starting at the first multiple of alignof(K) after the header,
+// - the N values, value i belonging to the interval starting at key i, starting at the first multiple of alignof(V)
+//   after the keys.
+// Keys and values are stored in the byte order and layout of the machine writing the file; a file written on a machine
+// with a different byte order or different sizes of K or V is rejected.
+template<class K, class V>
+class mapped_interval_map {
+	friend void IntervalMapTest();
+
+	static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+		"mapped_interval_map stores keys and values by their bytes");
+
+private:
+	struct header {
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t byte_order;
+		std::uint32_t key_size;
+		std::uint32_t value_size;
+		std::uint64_t count;
+	};
+
+	static const std::uint32_t format_version = 1;
+	static const std::uint32_t byte_order_mark = 0x01020304;
+
+	void* m_data;
+	std::size_t m_length;
+	K const* m_keys;
+	V const* m_values;
+	std::size_t m_count;
+
+public:
+	mapped_interval_map() : m_data(nullptr), m_length(0), m_keys(nullptr), m_values(nullptr), m_count(0) {}
+
+	mapped_interval_map( mapped_interval_map const& ) = delete;
+	mapped_interval_map& operator=( mapped_interval_map const& ) = delete;
+
+	mapped_interval_map( mapped_interval_map&& other ) : mapped_interval_map() {
+		swap(other);
+	}
+
+	mapped_interval_map& operator=( mapped_interval_map&& other ) {
+		mapped_interval_map(std::move(other)).swap(*this);
+		return *this;
+	}
+
+	~mapped_interval_map() {
+		close();
+	}
+
+	// Write the boundaries of map to the file at path, replacing it. The boundaries are streamed from the map through the
+	// buffer of a FILE, without copying the map. Returns false if the file could not be written, leaving path untouched.
+	// The file is written under a temporary name in the same directory, synced to disk and then renamed over path, so
+	// that processes which have the old file mapped keep reading it unchanged, and open() never sees a partly written
+	// file. Truncating the mapped file in place would make readers fault on pages past its new end. The new file gets
+	// the permissions of the one it replaces, or 0644.
+	// Complexity: O(N)
+	template<class Storage, class Allocator>
+	static bool write( interval_map<K,V,Storage,Allocator> const& map, char const* path ) {
+		static char const suffix[] = ".XXXXXX";
+		std::size_t const path_length = std::strlen(path);
+		std::vector<char> temp_path(path, path + path_length);
+		temp_path.insert(temp_path.end(), suffix, suffix + sizeof(suffix));
+		int fd = ::mkstemp(temp_path.data());
+		if(fd < 0)
+			return false;
+		struct stat st;
+		::fchmod(fd, ::stat(path, &st) == 0 ? st.st_mode & 07777 : 0644);
+		std::FILE* file = ::fdopen(fd, "wb");
+		if(!file) {
+			::close(fd);
+			::unlink(temp_path.data());
+			return false;
+		}
+
+		std::size_t const count = map.m_map.size();
+		header h = make_header(count);
+		bool ok = std::fwrite(&h, sizeof(h), 1, file) == 1;
+		ok = ok && write_padding(file, sizeof(h), keys_offset());
+		for(auto it = std::begin(map.m_map); ok && it != std::end(map.m_map); ++it)
+			ok = std::fwrite(&it->first, sizeof(K), 1, file) == 1;
+		ok = ok && write_padding(file, keys_offset() + count * sizeof(K), values_offset(count));
+		for(auto it = std::begin(map.m_map); ok && it != std::end(map.m_map); ++it)
+			ok = std::fwrite(&it->second, sizeof(V), 1, file) == 1;
+		ok = ok && std::fflush(file) == 0 && ::fsync(fd) == 0;
+
+		ok = std::fclose(file) == 0 && ok;
+		ok = ok && std::rename(temp_path.data(), path) == 0;
+		if(!ok)
+			::unlink(temp_path.data());
+		return ok;
+	}
+
+	// Map the file at path, written by write(), closing the file mapped so far. Returns false, leaving the map closed, if
+	// the file cannot be mapped or does not hold a valid map: the header has to match K and V and the file size has to
+	// match the header. Unless check_canonical is false, the boundaries are also checked to form a canonical interval
+	// map: the first key is std::numeric_limits<K>::min(), the keys are ascending and consecutive values differ.
+	// Complexity: O(1), O(N) with check_canonical, which reads the whole file once
+	bool open( char const* path, bool check_canonical = true ) {
+		close();
+
+		int fd = ::open(path, O_RDONLY);
+		if(fd < 0)
+			return false;
+		struct stat st;
+		void* data = MAP_FAILED;
+		if(::fstat(fd, &st) == 0 && st.st_size > 0)
+			data = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		// The mapping stays valid after the descriptor is closed.
+		::close(fd);
+		if(data == MAP_FAILED)
+			return false;
+
+		m_data = data;
+		m_length = static_cast<std::size_t>(st.st_size);
+		if(!attach() || (check_canonical && !is_canonical())) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+		if(m_data)
+			::munmap(m_data, m_length);
+		m_data = nullptr;
+		m_length = 0;
+		m_keys = nullptr;
+		m_values = nullptr;
+		m_count = 0;
+	}
+
+	bool is_open() const {
+		return m_data != nullptr;
+	}
+
+	// look-up of the value associated with key, the map has to be open
+	V const& operator[]( K const& key ) const {
+		assert(is_open());
+		return m_values[std::upper_bound(m_keys, m_keys + m_count, key) - m_keys - 1];
+	}
+
+	// number of boundaries
+	std::size_t size() const {
+		return m_count;
+	}
+
+	void swap( mapped_interval_map& other ) {
+		std::swap(m_data, other.m_data);
+		std::swap(m_length, other.m_length);
+		std::swap(m_keys, other.m_keys);
+		std::swap(m_values, other.m_values);
+		std::swap(m_count, other.m_count);
+	}
+
+private:
+	static std::size_t round_up( std::size_t offset, std::size_t alignment ) {
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	static std::size_t keys_offset() {
+		return round_up(sizeof(header), alignof(K));
+	}
+
+	static std::size_t values_offset( std::size_t count ) {
+		return round_up(keys_offset() + count * sizeof(K), alignof(V));
+	}
+
+	static header make_header( std::size_t count ) {
+		header h;
+		std::memset(&h, 0, sizeof(h));
+		std::memcpy(h.magic, "IVALMAP", 8);
+		h.version = format_version;
+		h.byte_order = byte_order_mark;
+		h.key_size = sizeof(K);
+		h.value_size = sizeof(V);
+		h.count = count;
+		return h;
+	}
+
+	static bool write_padding( std::FILE* file, std::size_t from, std::size_t to ) {
+		for(; from < to; ++from) {
+			if(std::fputc(0, file) == EOF)
+				return false;
+		}
+		return true;
+	}
+
+	// Check the header of the mapped file and point the arrays into it. The mapping is page aligned, so the arrays are
+	// aligned for K and V.
+	bool attach() {
+		if(m_length < sizeof(header))
+			return false;
+		header h;
+		std::memcpy(&h, m_data, sizeof(h));
+		header const expected = make_header(0);
+		if(std::memcmp(h.magic, expected.magic, sizeof(h.magic)) != 0 || h.version != expected.version
+			|| h.byte_order != expected.byte_order || h.key_size != expected.key_size || h.value_size != expected.value_size)
+			return false;
+		// An interval map has at least one boundary. Bound the count before computing offsets from it.
+		if(h.count == 0 || h.count > m_length / sizeof(K))
+			return false;
+		std::size_t const count = static_cast<std::size_t>(h.count);
+		if(values_offset(count) + count * sizeof(V) != m_length)
+			return false;
+
+		char const* data = static_cast<char const*>(m_data);
+		m_keys = reinterpret_cast<K const*>(data + keys_offset());
+		m_values = reinterpret_cast<V const*>(data + values_offset(count));
+		m_count = count;
+		return true;
+	}
+
+	bool is_canonical() const {
+		K const lowest = std::numeric_limits<K>::min();
+		if(lowest < m_keys[0] || m_keys[0] < lowest)
+			return false;
+		for(std::size_t i = 1; i < m_count; ++i) {
+			if(!(m_keys[i - 1] < m_keys[i]) || m_values[i - 1] == m_values[i])
+				return false;
+		}
+		return true;
+	}
+};
+#endif
+
+// concurrent_interval_map<K,V> is an interval map which can be read by any number of threads while it is written to.
+// Every assign creates a new immutable version of the map and publishes it atomically. Readers take a snapshot, which
+// is a reference counted pointer to the version current at that moment, and then look up values in it without any
+// synchronisation. Writers are serialised by a mutex, which readers never take.
+// Taking a snapshot is not free though: std::atomic_load of a std::shared_ptr is implemented with a lock in common
+// standard libraries (libstdc++ picks one of a few mutexes by the address of the pointer), which the writer publishing
+// a version takes as well, and it changes the reference count shared by all readers of the version. Readers looking up
+// many keys therefore hold a snapshot across the look-ups, or use a reader, which takes a new snapshot only after an
+// assign has published a new version, checking for one with a single atomic load per look-up. operator[] of the map
+// takes a snapshot for every look-up and is meant for occasional reads only.
+//
+// A version is a treap (a binary search tree which is a heap with respect to random node priorities, and thus balanced
+// with high probability) of immutable nodes. A new version shares all nodes with the previous one except those on the
+// paths which the assign changed, which are copied (path copying). Nodes are owned through std::shared_ptr, so nodes
+// which belong to no version held by the map or by a reader are freed as soon as the last holder lets them go.
+// Complexity: expected O(log N) for assign, of which a copy of O(log N) keys and values, and for look-up.
+template<class K, class V>
+class concurrent_interval_map {
+	friend void IntervalMapTest();
+
+private:
+	struct node;
+	typedef std::shared_ptr<const node> node_ptr;
+
+	struct node {
+		K key;
+		V value;
+		unsigned priority;
+		node_ptr left;
+		node_ptr right;
+	};
+
+	node_ptr m_root; // accessed through std::atomic_load and std::atomic_store only
+	std::atomic<std::size_t> m_version; // number of versions published, incremented after m_root is stored
+	std::mutex m_writer_mutex;
+	std::minstd_rand m_priorities;
+
+public:
+	// Immutable version of the map.
+	class snapshot {
+		friend class concurrent_interval_map;
+		friend void IntervalMapTest();
+
+		node_ptr m_root;
+
+		explicit snapshot(node_ptr root) : m_root(std::move(root)) {}
+
+	public:
+		// look-up of the value associated with key
+		// Complexity: expected logarithmic
+		V const& operator[]( K const& key ) const {
+			// Find the last boundary not greater than key. It always exists, the lowest boundary is the lowest value of K.
+			node const* found = nullptr;
+			for(node const* n = m_root.get(); n; ) {
+				if(key < n->key) {
+					n = n->left.get();
+				}
+				else {
+					found = n;
+					n = n->right.get();
+				}
+			}
+			return found->value;
+		}
+	};
+
+	// Cached snapshot of a map for a single thread, which is replaced by the current version when an assign has been
+	// published since it was taken. A look-up costs one atomic load of the version number of the map besides the
+	// look-up in the snapshot, and takes neither the lock of std::atomic_load nor a reference to the version, as long
+	// as the map is not assigned to. A reader must not be used by several threads at once, nor after its map is
+	// destroyed.
+	class reader {
+		friend class concurrent_interval_map;
+		friend void IntervalMapTest();
+
+		concurrent_interval_map const* m_owner;
+		std::size_t m_version; // version number of the map when m_snapshot was taken, or earlier
+		snapshot m_snapshot;
+
+		// The version number is read before the snapshot is taken, so the snapshot is at least that version.
+		explicit reader(concurrent_interval_map const& owner)
+			: m_owner(&owner), m_version(owner.m_version.load(std::memory_order_acquire)), m_snapshot(owner.get_snapshot()) {}
+
+	public:
+		// look-up of the value associated with key in the current version
+		// The reference stays valid until the next look-up through this reader.
+		// Complexity: expected logarithmic
+		V const& operator[]( K const& key ) {
+			std::size_t const version = m_owner->m_version.load(std::memory_order_acquire);
+			if(version != m_version) {
+				m_version = version;
+				m_snapshot = m_owner->get_snapshot();
+			}
+			return m_snapshot[key];
+		}
+	};
+
+	// constructor associates whole range of K with val
+	explicit concurrent_interval_map( V const& val ) : m_version(0) {
+		m_root = make_node(std::numeric_limits<K>::min(), val);
+	}
+
+	// Take a snapshot of the current version. It stays valid and unchanged however the map is assigned to afterwards.
+	snapshot get_snapshot() const {
+		return snapshot(std::atomic_load(&m_root));
+	}
+
+	// Make a reader for look-ups by one thread, see reader.
+	reader get_reader() const {
+		return reader(*this);
+	}
+
+	// look-up of the value associated with key in the current version
+	// The value is returned by copy, as the version it is stored in may be reclaimed as soon as this call returns.
+	// Every call takes a snapshot, see above; use a snapshot or a reader for many look-ups.
+	V operator[]( K const& key ) const {
+		return get_snapshot()[key];
+	}
+
+	// Assign value val to interval [keyBegin, keyEnd), with the same semantics as interval_map::assign,
+	// and publish the result as the new current version.
+	void assign( K const& keyBegin, K const& keyEnd, const V& val ) {
+		if(!(keyBegin < keyEnd))
+			return;
+
+		std::lock_guard<std::mutex> lock(m_writer_mutex);
+		// Cut the current version into the boundaries lower than keyBegin, the ones falling into the new interval
+		// and the ones from keyEnd on. The middle part is dropped from the new version.
+		node_ptr lower, rest, middle, upper;
+		split(std::atomic_load(&m_root), keyBegin, lower, rest);
+		split(rest, keyEnd, middle, upper);
+
+		// The value of the interval preceding the new one and the value from keyEnd on, before the assignment.
+		// before is missing only if keyBegin is the lowest value of K.
+		node const* before = rightmost(lower.get());
+		node const* upper_first = leftmost(upper.get());
+		bool end_is_boundary = upper_first && !(keyEnd < upper_first->key);
+		node const* end_node = end_is_boundary ? upper_first : middle ? rightmost(middle.get()) : before;
+
+		// Keep the map canonical: the lower boundary is needed only if the preceding value is different,
+		// an existing boundary at keyEnd is dropped if its value becomes the same as the preceding one,
+		// and a missing boundary at keyEnd is needed only if the value from keyEnd on differs from val.
+		// lower is kept, as before and end_node may point into it.
+		node_ptr result = lower;
+		if(!before || !(before->value == val))
+			result = merge(result, make_node(keyBegin, val));
+		if(end_is_boundary) {
+			if(upper_first->value == val)
+				upper = pop_front(upper);
+		}
+		else if(!(end_node->value == val)) {
+			result = merge(result, make_node(keyEnd, end_node->value));
+		}
+		result = merge(result, upper);
+
+		std::atomic_store(&m_root, std::move(result));
+		m_version.fetch_add(1, std::memory_order_release);
+	}
+
+private:
+	node_ptr make_node( K const& key, V const& value ) {
+		return std::make_shared<const node>(node{key, value, static_cast<unsigned>(m_priorities()), nullptr, nullptr});
+	}
+
+	// Copy of n with the given children.
+	static node_ptr copy_node( node const& n, node_ptr left, node_ptr right ) {
+		return std::make_shared<const node>(node{n.key, n.value, n.priority, std::move(left), std::move(right)});
+	}
+
+	// Split the tree t into the nodes with keys lower than key and the remaining ones, copying the nodes on the path to key.
+	static void split( node_ptr const& t, K const& key, node_ptr& lower, node_ptr& rest ) {
+		if(!t) {
+			lower = rest = nullptr;
+		}
+		else if(t->key < key) {
+			node_ptr right_lower;
+			split(t->right, key, right_lower, rest);
+			lower = copy_node(*t, t->left, std::move(right_lower));
+		}
+		else {
+			node_ptr left_rest;
+			split(t->left, key, lower, left_rest);
+			rest = copy_node(*t, std::move(left_rest), t->right);
+		}
+	}
+
+	// Join two trees, all keys of a being lower than all keys of b, copying the nodes on the seam.
+	static node_ptr merge( node_ptr const& a, node_ptr const& b ) {
+		if(!a)
+			return b;
+		if(!b)
+			return a;
+		if(a->priority > b->priority)
+			return copy_node(*a, a->left, merge(a->right, b));
+		return copy_node(*b, merge(a, b->left), b->right);
+	}
+
+	// Tree t without its lowest node.
+	static node_ptr pop_front( node_ptr const& t ) {
+		if(!t->left)
+			return t->right;
+		return copy_node(*t, pop_front(t->left), t->right);
+	}
+
+	static node const* leftmost( node const* n ) {
+		while(n && n->left)
+			n = n->left.get();
+		return n;
+	}
+
+	static node const* rightmost( node const* n ) {
+		while(n && n->right)
+			n = n->right.get();
+		return n;
+	}
+};
+
+// sharded_interval_map<K,V> splits the key domain into shards at given keys. Each shard is an interval_map with its own
+// mutex, so that threads assigning to different shards do not wait for each other. Shard i covers the keys from
+// split point i-1 (including, the lowest value of K for the first shard) to split point i (excluding, up to the highest
+// value of K for the last shard). Keys outside of the range of a shard keep their initial value in its interval_map.
+// An assign crossing split points is divided into one assign per shard; the affected shards are locked in ascending
+// order for the whole assign, so that readers never observe it half applied. Every shard is canonical on its own,
+// only the boundaries at the split points may be redundant in the combined map.
+template<class K, class V, class Storage = map_storage>
+class sharded_interval_map {
+	friend void IntervalMapTest();
+
+private:
+	struct shard {
+		std::mutex mutex;
+		interval_map<K,V,Storage> map;
+
+		explicit shard( V const& val ) : map(val) {}
+	};
+
+	std::vector<K> m_split_points;
+	std::vector<std::unique_ptr<shard>> m_shards;
+
+public:
+	// constructor associates whole range of K with val, split_points have to be sorted in ascending order and distinct
+	sharded_interval_map( V const& val, std::vector<K> split_points ) : m_split_points(std::move(split_points)) {
+		assert(std::adjacent_find(m_split_points.begin(), m_split_points.end(),
+			[](K const& a, K const& b) { return !(a < b); }) == m_split_points.end());
+		for(std::size_t i = 0; i <= m_split_points.size(); ++i)
+			m_shards.push_back(std::unique_ptr<shard>(new shard(val)));
+	}
+
+	// Assign value val to interval [keyBegin, keyEnd), with the same semantics as interval_map::assign.
+	// Complexity: logarithmic in the number of shards, plus the assign in every shard the interval overlaps
+	void assign( K const& keyBegin, K const& keyEnd, const V& val ) {
+		if(!(keyBegin < keyEnd))
+			return;
+
+		std::size_t first = shard_index(keyBegin);
+		std::size_t last = first;
+		while(last < m_split_points.size() && m_split_points[last] < keyEnd)
+			++last;
+
+		std::vector<std::unique_lock<std::mutex>> locks;
+		for(std::size_t i = first; i <= last; ++i)
+			locks.push_back(std::unique_lock<std::mutex>(m_shards[i]->mutex));
+
+		for(std::size_t i = first; i <= last; ++i) {
+			K const& begin = i == first ? keyBegin : m_split_points[i - 1];
+			K const& end = i == last ? keyEnd : m_split_points[i];
+			m_shards[i]->map.assign(begin, end, val);
+		}
+	}
+
+	// look-up of the value associated with key
+	// The value is returned by copy, as it may be overwritten by another thread as soon as the shard is unlocked.
+	V operator[]( K const& key ) const {
+		shard& s = *m_shards[shard_index(key)];
+		std::lock_guard<std::mutex> lock(s.mutex);
+		return s.map[key];
+	}
+
+	std::size_t shard_count() const {
+		return m_shards.size();
+	}
+
+	// number of boundaries of all shards, including those at the split points
+	std::size_t size() const {
+		std::size_t boundaries = 0;
+		for(auto const& s : m_shards) {
+			std::lock_guard<std::mutex> lock(s->mutex);
+			boundaries += s->map.size();
+		}
+		return boundaries;
+	}
+
+private:
+	std::size_t shard_index( K const& key ) const {
+		return std::upper_bound(m_split_points.begin(), m_split_points.end(), key) - m_split_points.begin();
+	}
+};
+
+// Interval [begin, end) in which the assignment at index was the last one written, see resolve_assignments().
+template<class K>
+struct resolved_interval {
+	K begin;
+	K end;
+	std::size_t index;
+};
+
+// Resolve the non-empty assignments [first, last), objects with begin and end members applied in this order, into the
+// ascending disjoint intervals of keys which the same assignment was the last one to cover, appending them to out.
+// Keys which no assignment covers are left out. Adjacent intervals of the same assignment are joined.
+// The ends of the assignments are sorted, each tagged with the index of its assignment, then a sweep over them keeps
+// the assignments covering the current key in a heap, the last written one on top. Assignments which have ended are
+// only removed once they reach the top.
+// Complexity: O(M log M) where M is the number of assignments
+template<class K, class RandomIt>
+void resolve_assignments( RandomIt first, RandomIt last, std::vector<resolved_interval<K>>& out ) {
+	std::size_t const count = static_cast<std::size_t>(last - first);
+	// The beginning of assignment i is marked by i+1 and its end by -(i+1).
+	std::vector<std::pair<K,std::ptrdiff_t>> ends;
+	ends.reserve(2 * count);
+	for(std::size_t i = 0; i < count; ++i) {
+		ends.push_back(std::make_pair(first[i].begin, static_cast<std::ptrdiff_t>(i + 1)));
+		ends.push_back(std::make_pair(first[i].end, -static_cast<std::ptrdiff_t>(i + 1)));
+	}
+	std::sort(ends.begin(), ends.end(), [](std::pair<K,std::ptrdiff_t> const& a, std::pair<K,std::ptrdiff_t> const& b) {
+		return a.first < b.first;
+	});
+
+	std::size_t const joined = out.size();
+	std::priority_queue<std::size_t> covering;
+	std::vector<bool> ended(count, false);
+	for(std::size_t e = 0; e < ends.size(); ) {
+		K const& key = ends[e].first;
+		for(; e < ends.size() && !(key < ends[e].first); ++e) {
+			if(ends[e].second > 0)
+				covering.push(static_cast<std::size_t>(ends[e].second - 1));
+			else
+				ended[static_cast<std::size_t>(-ends[e].second - 1)] = true;
+		}
+		while(!covering.empty() && ended[covering.top()])
+			covering.pop();
+		// The last end closes every assignment, so there is a next key whenever an assignment covers this one.
+		if(covering.empty())
+			continue;
+		std::size_t const index = covering.top();
+		if(out.size() > joined && out.back().index == index && !(out.back().end < key))
+			out.back().end = ends[e].first;
+		else
+			out.push_back(resolved_interval<K>{key, ends[e].first, index});
+	}
+}
+
+// Assign the resolved intervals to map, each with the value of its assignment in the sequence starting at items.
+// Complexity: a sweep over the map, like assign_sorted()
+template<class K, class V, class Storage, class Allocator, class RandomIt>
+void assign_resolved( interval_map<K,V,Storage,Allocator>& map, std::vector<resolved_interval<K>> const& resolved, RandomIt items ) {
+	struct segment {
+		K const& begin;
+		K const& end;
+		V const& value;
+	};
+	std::vector<segment> segments;
+	segments.reserve(resolved.size());
+	for(auto const& r : resolved)
+		segments.push_back(segment{r.begin, r.end, items[r.index].value});
+	map.assign_sorted(segments.begin(), segments.end());
+}
+
+// deferred_interval_map<K,V> is an interval map for bursts of assigns which overwrite each other, followed by reads.
+// assign only appends the interval to a log. The log is resolved on the next read, or by flush(): resolve_assignments()
+// finds which of the logged intervals is the last one written at every key, and the resulting disjoint intervals are
+// assigned in ascending order in a single sweep over the map. Thus M logged assigns cost
+// O(M log M) plus a sweep over the map, instead of M separate updates which erase the boundaries written by the
+// previous ones. The resulting map is the same as if every assign had been applied when it was called.
+// This pays off for large maps, in which an assign misses the cache on every level of the tree. The sort of the log
+// costs more than an assign to a small map, which stays in the cache.
+// Reads resolve the log, modifying the map although they are const, so not even reads may be concurrent.
+template<class K, class V, class Storage = map_storage>
+class deferred_interval_map {
+	friend void IntervalMapTest();
+
+private:
+	mutable interval_map<K,V,Storage> m_map;
+	mutable std::vector<interval<K,V>> m_log;
+
+public:
+	// constructor associates whole range of K with val
+	explicit deferred_interval_map( V const& val ) : m_map(val) {}
+
+	// Log the assign of value val to interval [keyBegin, keyEnd), with the same semantics as interval_map::assign.
+	// Complexity: amortized constant
+	void assign( K const& keyBegin, K const& keyEnd, V const& val ) {
+		if(keyBegin < keyEnd)
+			m_log.push_back(interval<K,V>{keyBegin, keyEnd, val});
+	}
+
+	void assign( K const& keyBegin, K const& keyEnd, V&& val ) {
+		if(keyBegin < keyEnd)
+			m_log.push_back(interval<K,V>{keyBegin, keyEnd, std::move(val)});
+	}
+
+	// Apply the logged assigns to the map.
+	// Complexity: O(M log M) where M is the number of logged assigns, plus a sweep over the map
+	void flush() const {
+		if(m_log.empty())
+			return;
+
+		std::vector<resolved_interval<K>> resolved;
+		resolve_assignments(m_log.begin(), m_log.end(), resolved);
+		assign_resolved(m_map, resolved, m_log.begin());
+		m_log.clear();
+	}
+
+	// look-up of the value associated with key, applying the logged assigns first
+	V const& operator[]( K const& key ) const {
+		flush();
+		return m_map[key];
+	}
+
+	// Call visitor(begin, end, value) like interval_map::for_each_interval does, applying the logged assigns first.
+	template<class Visitor>
+	void for_each_interval( K const& keyBegin, K const& keyEnd, Visitor visitor ) const {
+		flush();
+		m_map.for_each_interval(keyBegin, keyEnd, visitor);
+	}
+
+	// number of boundaries, applying the logged assigns first
+	std::size_t size() const {
+		flush();
+		return m_map.size();
+	}
+
+	// number of logged assigns not applied yet
+	std::size_t pending() const {
+		return m_log.size();
+	}
+};
+
+// Number of threads build_interval_map() uses for count intervals when given up to threads threads: every thread gets
+// at least 1024 intervals, fewer are not worth the cost of starting it.
+inline unsigned build_interval_map_threads( std::size_t count, unsigned threads ) {
+	return static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(threads, count / 1024)));
+}
+
+// Build the interval_map which results from assigning the intervals [first, last), objects with begin, end and value
+// members such as interval<K,V>, in this order to a map associating the whole range of K with val, using up to threads
+// threads, see build_interval_map_threads(). The map is the same as the one replaying the assigns, including empty
+// intervals, which are ignored.
+// The key domain is divided into one range per thread at keys sampled from the beginnings of the intervals. Then, all
+// in parallel:
+// - every thread clips the intervals of its slice of the input to the ranges they overlap, bucketing the pieces by
+//   range, so that the input is read once in total,
+// - every thread gathers the pieces of its range from all buckets, in input order, resolves them with
+//   resolve_assignments() and turns the result into a canonical run of boundaries, the first one at the beginning of
+//   the range.
+// The runs are joined, dropping the first boundary of a run if it has the value of the last one kept, and appended to
+// the new map with assign_boundaries(). This last step is not parallel: it allocates and inserts every boundary of the
+// map, though without any search or comparison of values.
+// Complexity: O(M log M / T) for M intervals and T threads, plus O(B) for the B boundaries of the map in one thread
+template<class K, class V, class Storage = map_storage, class RandomIt>
+interval_map<K,V,Storage> build_interval_map( V const& val, RandomIt first, RandomIt last, unsigned threads ) {
+	struct clipped {
+		K begin;
+		K end;
+		V const& value;
+	};
+
+	struct boundary {
+		K const& begin;
+		V const& value;
+	};
+
+	std::size_t const count = static_cast<std::size_t>(last - first);
+	threads = build_interval_map_threads(count, threads);
+
+	// Split keys at evenly spaced ranks of a sorted sample of the beginnings.
+	std::vector<K> splits;
+	if(threads > 1) {
+		std::vector<K> sample;
+		std::size_t const stride = std::max<std::size_t>(1, count / (64 * threads));
+		for(std::size_t i = 0; i < count; i += stride)
+			sample.push_back(first[i].begin);
+		std::sort(sample.begin(), sample.end());
+		for(unsigned t = 1; t < threads; ++t) {
+			K const& split = sample[t * sample.size() / threads];
+			if(splits.empty() || splits.back() < split)
+				splits.push_back(split);
+		}
+	}
+
+	// Range r covers the keys from splits[r-1] (including) to splits[r] (excluding), unbounded at the ends.
+	// buckets[t][r] holds the pieces which the intervals of slice t of the input have in range r.
+	std::size_t const range_count = splits.size() + 1;
+	std::vector<std::vector<std::vector<clipped>>> buckets(threads, std::vector<std::vector<clipped>>(range_count));
+	auto clip_slice = [&](std::size_t t) {
+		for(RandomIt it = first + t * count / threads; it != first + (t + 1) * count / threads; ++it) {
+			if(!(it->begin < it->end))
+				continue;
+			std::size_t r = std::upper_bound(splits.begin(), splits.end(), it->begin) - splits.begin();
+			K const* begin = &it->begin;
+			while(r < splits.size() && splits[r] < it->end) {
+				buckets[t][r].push_back(clipped{*begin, splits[r], it->value});
+				begin = &splits[r++];
+			}
+			buckets[t][r].push_back(clipped{*begin, it->end, it->value});
+		}
+	};
+
+	K const lowest = std::numeric_limits<K>::min();
+	std::vector<std::vector<clipped>> ranges(range_count);
+	std::vector<std::vector<resolved_interval<K>>> resolved(range_count);
+	std::vector<std::vector<boundary>> runs(range_count);
+	auto build_run = [&](std::size_t r) {
+		std::size_t pieces = 0;
+		for(auto const& slice : buckets)
+			pieces += slice[r].size();
+		ranges[r].reserve(pieces);
+		for(auto const& slice : buckets) {
+			for(auto const& piece : slice[r])
+				ranges[r].push_back(piece);
+		}
+		resolve_assignments(ranges[r].begin(), ranges[r].end(), resolved[r]);
+
+		// The keys up to the first resolved interval, between resolved intervals and after the last one keep val.
+		std::vector<boundary>& run = runs[r];
+		auto append = [&run](K const& begin, V const& value) {
+			if(run.empty() || !(run.back().value == value))
+				run.push_back(boundary{begin, value});
+		};
+		K const* position = r == 0 ? &lowest : &splits[r - 1];
+		for(auto const& item : resolved[r]) {
+			if(*position < item.begin)
+				append(*position, val);
+			append(item.begin, ranges[r][item.index].value);
+			position = &item.end;
+		}
+		if(r == splits.size() || *position < splits[r])
+			append(*position, val);
+	};
+
+	auto run_in_parallel = [](std::size_t tasks, std::function<void(std::size_t)> const& task) {
+		std::vector<std::thread> workers;
+		for(std::size_t i = 1; i < tasks; ++i)
+			workers.push_back(std::thread(task, i));
+		task(0);
+		for(auto& worker : workers)
+			worker.join();
+	};
+	run_in_parallel(threads, clip_slice);
+	run_in_parallel(range_count, build_run);
+
+	std::vector<boundary> boundaries;
+	std::size_t total = 0;
+	for(auto const& run : runs)
+		total += run.size();
+	boundaries.reserve(total);
+	for(auto const& run : runs) {
+		auto it = run.begin();
+		if(!boundaries.empty() && boundaries.back().value == it->value)
+			++it;
+		for(; it != run.end(); ++it)
+			boundaries.push_back(*it);
+	}
+
+	interval_map<K,V,Storage> map(val);
+	map.assign_boundaries(boundaries.begin(), boundaries.end());
+	return map;
+}
+
+// interned_interval_map<K,V> is an interval map for values which are large or repeat a lot. Every distinct value is
+// stored once in a value table, and the map stores a small integer handle per boundary instead of the value, so that
+// a boundary takes roughly the memory of a key and a handle, and assign compares handles instead of values. The default
+// storage is a B+-tree, which has no per boundary overhead besides these.
+// Assigning a value looks it up in the table, which needs V to be hashable by Hash. Values are never removed from the
+// table, even when no interval has them any more, so the table holds every distinct value ever assigned.
+// Look-ups return a reference into the table, which stays valid for the lifetime of the map.
+template<class K, class V, class Storage = btree_storage<>, class Hash = std::hash<V>, class Handle = std::uint32_t>
+class interned_interval_map {
+	friend void IntervalMapTest();
+
+private:
+	// The table owns the values as keys of m_handles, whose nodes never move, and m_values points to them by handle.
+	std::unordered_map<V,Handle,Hash> m_handles;
+	std::vector<V const*> m_values;
+	interval_map<K,Handle,Storage> m_map;
+
+public:
+	// constructor associates whole range of K with val
+	explicit interned_interval_map( V const& val ) : m_map(intern(val)) {}
+
+	// A copy gets its own value table, m_values is pointed at the values in it.
+	interned_interval_map( interned_interval_map const& other )
+		: m_handles(other.m_handles), m_values(other.m_values.size()), m_map(other.m_map) {
+		for(auto it = std::begin(m_handles); it != std::end(m_handles); ++it)
+			m_values[it->second] = &it->first;
+	}
+
+	interned_interval_map& operator=( interned_interval_map const& other ) {
+		if(this != &other)
+			*this = interned_interval_map(other);
+		return *this;
+	}
+
+	// The nodes of m_handles are taken over, so m_values stays valid.
+	interned_interval_map( interned_interval_map&& ) = default;
+	interned_interval_map& operator=( interned_interval_map&& ) = default;
+
+	// Assign value val to interval [keyBegin, keyEnd), with the same semantics as interval_map::assign.
+	// Complexity: the assign of interval_map, plus an expected constant time look-up of val in the value table
+	void assign( K const& keyBegin, K const& keyEnd, V const& val ) {
+		if(keyBegin < keyEnd)
+			m_map.assign(keyBegin, keyEnd, intern(val));
+	}
+
+	// Like the above, but val is moved into the value table if it is not there yet.
+	void assign( K const& keyBegin, K const& keyEnd, V&& val ) {
+		if(keyBegin < keyEnd)
+			m_map.assign(keyBegin, keyEnd, intern(std::move(val)));
+	}
+
+	// look-up of the value associated with key
+	V const& operator[]( K const& key ) const {
+		return *m_values[m_map[key]];
+	}
+
+	// Call visitor(begin, end, value) like interval_map::for_each_interval does.
+	template<class Visitor>
+	void for_each_interval( K const& keyBegin, K const& keyEnd, Visitor visitor ) const {
+		m_map.for_each_interval(keyBegin, keyEnd, [this, &visitor](K const& begin, K const& end, Handle const& handle) {
+			visitor(begin, end, *m_values[handle]);
+		});
+	}
+
+	// number of boundaries
+	std::size_t size() const {
+		return m_map.size();
+	}
+
+	// number of distinct values in the value table
+	std::size_t value_count() const {
+		return m_values.size();
+	}
+
+private:
+	// handle of val, adding val to the value table if it is not there yet
+	template<class Val>
+	Handle intern( Val&& val ) {
+		auto it = m_handles.find(val);
+		if(it == std::end(m_handles)) {
+			assert(m_values.size() <= std::numeric_limits<Handle>::max());
+			it = m_handles.emplace(std::forward<Val>(val), static_cast<Handle>(m_values.size())).first;
+			m_values.push_back(&it->first);
+		}
+		return it->second;
+	}
+};
+
+/*
+The following paragraphs from the final draft of the C++1x ISO standard describe the available 
+operations on a std::map container, their effects and their complexity.
+
+23.2.1 General container requirements 
+
+�1	Containers are objects that store other objects. They control allocation and deallocation of 
+these objects through constructors, destructors, insert and erase operations.
+
+�6	begin() returns an iterator referring to the first element in the container. end() returns 
+an iterator which is the past-the-end value for the container. If the container is empty, 
+then begin() == end();
+
+24.2.1 General Iterator Requirements
+
+�1	Iterators are a generalization of pointers that allow a C++ program to work with different 
+data structures.
+
+�2	Since iterators are an abstraction of pointers, their semantics is a generalization of most 
+of the semantics of pointers in C++. This ensures that every function template that takes 
+iterators works as well with regular pointers.
+
+�5	Just as a regular pointer to an array guarantees that there is a pointer value pointing past 
+the last element of the array, so for any iterator type there is an iterator value that points 
+past the last element of a corresponding sequence. These values are called past-the-end values. 
+Values of an iterator i for which the expression *i is defined are called dereferenceable. 
+The library never assumes that past-the-end values are dereferenceable. Iterators can also have 
+singular values that are not associated with any sequence. [ Example: After the declaration of 
+an uninitialized pointer x (as with int* x;), x  must always be assumed to have a singular 
+value of a pointer. �end example ] Results of most expressions are undefined for singular 
+values; the only exceptions are destroying an iterator that holds a singular value, the 
+assignment of a non-singular value to an iterator that holds a singular value, and, for 
+iterators that satisfy the DefaultConstructible requirements, using a value-initialized 
+iterator as the source of a copy or move operation.
+
+�10 An invalid iterator is an iterator that may be singular. (This definition applies to pointers, 
+since pointers are iterators. The effect of dereferencing an iterator that has been invalidated 
+is undefined.)
+
+23.2.4 Associative containers
+
+�1	Associative containers provide fast retrieval of data based on keys. The library provides four 
+basic kinds of associative containers: set, multiset, map and multimap.
+
+�4	An associative container supports unique keys if it may contain at most one element for each key. 
+Otherwise, it supports equivalent keys. The set and map classes support unique keys; the multiset 
+and multimap classes support equivalent keys.
+
+�5	For map and multimap the value type is equal to std::pair<const Key, T>. Keys in an associative 
+container are immutable.
+
+�6	iterator of an associative container is of the bidirectional iterator category.
+(i.e., an iterator i can be incremented and decremented: ++i; --i;)
+
+�9	The insert member functions (see below) shall not affect the validity of iterators and references 
+to the container, and the erase members shall invalidate only iterators and references to the erased 
+elements.
+
+�10	The fundamental property of iterators of associative containers is that they iterate through the 
+containers in the non-descending order of keys where non-descending is defined by the comparison 
+that was used to construct them.
+
+Associative container requirements (in addition to general container requirements):
+
+std::pair<iterator, bool> insert(std::pair<const key_type, T> const& t)
+Effects: Inserts t if and only if there is no element in the container with key equivalent to the key of t. 
+The bool component of the returned pair is true if and only if the insertion takes place, and the iterator 
+component of the pair points to the element with key equivalent to the key of t.
+Complexity: logarithmic
+
+iterator insert(const_iterator p, std::pair<const key_type, T> const& t)
+Effects: Inserts t if and only if there is no element with key equivalent to the key of t in containers with
+unique keys. Always returns the iterator pointing to the element with key equivalent to the key of t.
+Complexity: logarithmic in general, but amortized constant if t is inserted right before p.
+
+size_type erase(key_type const& k)  
+Effects: Erases all elements in the container with key equivalent to k. Returns the number of erased elements.
+Complexity: log(size of container) + number of elements with key k
+
+iterator erase(const_iterator q) 
+Effects: Erases the element pointed to by q. Returns an iterator pointing to the element immediately following 
+q prior to the element being erased. If no such element exists, returns end().
+Complexity: Amortized constant
+
+iterator erase(const_iterator q1, const_iterator q2)
+Effects: Erases all the elements in the left-inclusive and right-exclusive range [q1,q2). Returns q2.
+Complexity: Amortized O(N) where N has the value distance(q1, q2).
+
+void clear() 
+Effects: erase(begin(), end())
+Post-Condition: empty() returns true
+Complexity: linear in size().
+
+iterator find(key_type const& k);
+Effects: Returns an iterator pointing to an element with the key equivalent to k, or end() if such an element is not found
+Complexity: logarithmic
+
+size_type count(key_type const& k) 
+Effects: Returns the number of elements with key equivalent to k
+Complexity: log(size of map) + number of elements with key equivalent to k
+
+iterator lower_bound(key_type const& k)
+Effects: Returns an iterator pointing to the first element with key not less than k, or end() if such an element is not found.
+Complexity: logarithmic
+
+iterator upper_bound(key_type const& k)
+Effects: Returns an iterator pointing to the first element with key greater than k, or end() if such an element is not found.
+Complexity: logarithmic
+
+23.4.1 Class template map
+
+�1 	A map is an associative container that supports unique keys (contains at most one of each key value) and provides 
+for fast retrieval of values of another type T based on the keys. The map class supports bidirectional iterators.
+
+23.4.1.2 map element access
+
+T& operator[](const key_type& x);
+Effects: If there is no key equivalent to x in the map, inserts value_type(x, T()) into the map. 
+Returns: A reference to the mapped_type corresponding to x in *this.
+Complexity: logarithmic.
+
+T& at(const key_type& x);
+const T& at(const key_type& x) const;
+Returns: A reference to the element whose key is equivalent to x.
+Throws: An exception object of type out_of_range if no such element is present.
+Complexity: logarithmic.
+*/
+
+#endif
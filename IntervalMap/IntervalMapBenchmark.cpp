@@ -0,0 +1,284 @@
+#include "IntervalMap.h"
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// Benchmarks of the hot paths of interval_map, assign and look-up, for every backend and several distributions of the
+// assigned intervals. Every measurement is printed as one tab separated line, after a header line naming the columns:
+// - benchmark: the operation measured,
+//   assign - assign() of every interval of the distribution, in the generated order,
+//   assign_deferred - the same with deferred_interval_map, including the final flush(),
+//   build - build_interval_map() of the same intervals on 1, 2, 4, ... up to all hardware threads,
+//   lookup - operator[] of random keys,
+//   lookup_sorted - operator[] of the same keys in ascending order,
+//   lookup_batch - lookup() of the keys in ascending order,
+//   lookup_cursor - look-up of the keys in ascending order through a cursor,
+// - backend: map (interval_map with map_storage), btree (interval_map with btree_storage), frozen (frozen_interval_map
+//   made of the map) or sharded (sharded_interval_map),
+// - distribution: the intervals assigned, see make_distribution(),
+// - threads: the number of threads calling the operation, for build the number build_interval_map() actually uses,
+// - operations: the number of calls measured,
+// - ns_per_op: wall clock time per call,
+// - boundaries: the number of boundaries of the map after the assigns,
+// - peak_bytes: the most memory the map has held at once, - if not measured.
+// The peak resident set size of the whole process is printed to std::cerr at the end.
+// Pass --quick to run with small sizes only, e.g. as a smoke test.
+
+namespace {
+
+struct distribution {
+	char const* name;
+	std::vector<interval<int,int>> intervals;
+	std::vector<int> keys; // random look-up keys covering the assigned intervals
+	std::vector<int> sorted_keys;
+};
+
+// The intervals of a distribution have random values out of 16, so that neighbours are mostly distinct.
+// - uniform: intervals of up to 1024 keys starting anywhere in [0, 2^24),
+// - append: adjacent intervals of up to 16 keys, each starting at the end of the previous one,
+// - overlap: intervals of 2^18 to 2^20 keys in [0, 2^21), every one overwriting dozens of boundaries,
+// - dense: intervals between keys in [0, 500], like the randomised tests use, so the map stays small,
+// - large: intervals of up to 16 keys starting anywhere in [0, 2^30), assigned four times as often as the others.
+distribution make_distribution( char const* name, std::size_t count ) {
+	distribution d;
+	d.name = name;
+	std::default_random_engine gen(12345);
+	std::uniform_int_distribution<> dis_value(0, 15);
+	std::uniform_int_distribution<> dis_uniform(0, (1 << 24) - 1), dis_uniform_length(1, 1 << 10);
+	std::uniform_int_distribution<> dis_overlap(0, (1 << 20) - 1), dis_overlap_length(1 << 18, 1 << 20);
+	std::uniform_int_distribution<> dis_dense(0, 500);
+	std::uniform_int_distribution<> dis_large(0, (1 << 30) - 1), dis_short_length(1, 16);
+
+	bool const large = std::strcmp(name, "large") == 0;
+	if(large)
+		count *= 4;
+	int end = 0;
+	for(std::size_t i = 0; i < count; i++) {
+		int begin;
+		if(std::strcmp(name, "uniform") == 0) {
+			begin = dis_uniform(gen);
+			end = begin + dis_uniform_length(gen);
+		}
+		else if(std::strcmp(name, "append") == 0) {
+			begin = end;
+			end = begin + dis_short_length(gen);
+		}
+		else if(std::strcmp(name, "overlap") == 0) {
+			begin = dis_overlap(gen);
+			end = begin + dis_overlap_length(gen);
+		}
+		else if(std::strcmp(name, "dense") == 0) {
+			begin = dis_dense(gen);
+			end = dis_dense(gen);
+			if(end < begin)
+				std::swap(begin, end);
+		}
+		else {
+			assert(large);
+			begin = dis_large(gen);
+			end = begin + dis_short_length(gen);
+		}
+		d.intervals.push_back(interval<int,int>{begin, end, dis_value(gen)});
+	}
+
+	int key_max = 0;
+	for(auto const& item : d.intervals)
+		key_max = std::max(key_max, item.end);
+	std::uniform_int_distribution<> dis_key(-1, key_max);
+	for(std::size_t i = 0; i < count; i++)
+		d.keys.push_back(dis_key(gen));
+	d.sorted_keys = d.keys;
+	std::sort(d.sorted_keys.begin(), d.sorted_keys.end());
+	return d;
+}
+
+template<class Function>
+double elapsed_ns( Function function ) {
+	auto start = std::chrono::steady_clock::now();
+	function();
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report( char const* benchmark, char const* backend, char const* distribution, unsigned threads,
+	std::size_t operations, double ns, std::size_t boundaries, std::size_t peak_bytes ) {
+	std::cout << benchmark << '\t' << backend << '\t' << distribution << '\t' << threads << '\t' << operations << '\t'
+		<< std::fixed << std::setprecision(1) << ns / operations << '\t' << boundaries << '\t';
+	if(peak_bytes)
+		std::cout << peak_bytes;
+	else
+		std::cout << '-';
+	std::cout << std::endl;
+}
+
+// Keeps the compiler from optimising away the values looked up.
+volatile int sink;
+
+template<class Map>
+void benchmark_lookup( char const* backend, Map const& map, distribution const& d, std::size_t peak_bytes ) {
+	int sum = 0;
+	double ns = elapsed_ns([&]() {
+		for(int key : d.keys)
+			sum += map[key];
+	});
+	report("lookup", backend, d.name, 1, d.keys.size(), ns, map.size(), peak_bytes);
+
+	ns = elapsed_ns([&]() {
+		for(int key : d.sorted_keys)
+			sum += map[key];
+	});
+	report("lookup_sorted", backend, d.name, 1, d.sorted_keys.size(), ns, map.size(), peak_bytes);
+	sink = sum;
+}
+
+template<class Storage>
+void benchmark_backend( char const* backend, distribution const& d, bool with_frozen ) {
+	typedef resource_allocator<std::pair<const int,int>, counting_resource> allocator;
+	counting_resource resource;
+	interval_map<int,int,Storage,allocator> im(-1, allocator(resource));
+
+	double ns = elapsed_ns([&]() {
+		for(auto const& item : d.intervals)
+			im.assign(item.begin, item.end, item.value);
+	});
+	report("assign", backend, d.name, 1, d.intervals.size(), ns, im.size(), resource.peak());
+
+	benchmark_lookup(backend, im, d, resource.peak());
+
+	std::vector<int const*> values(d.sorted_keys.size());
+	ns = elapsed_ns([&]() {
+		im.lookup(d.sorted_keys.begin(), d.sorted_keys.end(), values.begin());
+	});
+	report("lookup_batch", backend, d.name, 1, d.sorted_keys.size(), ns, im.size(), resource.peak());
+	sink = *values.back();
+
+	auto cursor = im.get_cursor();
+	int sum = 0;
+	ns = elapsed_ns([&]() {
+		for(int key : d.sorted_keys)
+			sum += cursor[key];
+	});
+	report("lookup_cursor", backend, d.name, 1, d.sorted_keys.size(), ns, im.size(), resource.peak());
+	sink = sum;
+
+	deferred_interval_map<int,int,Storage> deferred(-1);
+	ns = elapsed_ns([&]() {
+		for(auto const& item : d.intervals)
+			deferred.assign(item.begin, item.end, item.value);
+		deferred.flush();
+	});
+	report("assign_deferred", backend, d.name, 1, d.intervals.size(), ns, deferred.size(), 0);
+
+	// The thread counts double up to the number of hardware threads, so that the rows show how the build scales. Counts
+	// which build_interval_map() reduces to one already measured are skipped.
+	unsigned const max_threads = build_interval_map_threads(d.intervals.size(), std::max(1u, std::thread::hardware_concurrency()));
+	for(unsigned requested = 1; ; requested = std::min(2 * requested, max_threads)) {
+		unsigned const threads = build_interval_map_threads(d.intervals.size(), requested);
+		std::size_t boundaries = 0;
+		ns = elapsed_ns([&]() {
+			boundaries = build_interval_map<int,int,Storage>(-1, d.intervals.begin(), d.intervals.end(), threads).size();
+		});
+		report("build", backend, d.name, threads, d.intervals.size(), ns, boundaries, 0);
+		if(threads == max_threads)
+			break;
+	}
+
+	if(with_frozen) {
+		frozen_interval_map<int,int> frozen(im);
+		// The frozen map holds exactly one key and one value per boundary.
+		benchmark_lookup("frozen", frozen, d, frozen.size() * (sizeof(int) + sizeof(int)));
+	}
+}
+
+// Measures how the throughput of assign on a sharded_interval_map scales with the number of threads, from 1 up to the
+// number of hardware threads. Every thread assigns random intervals within its own part of the key domain. Intervals
+// are up to twice as long as a shard, so many of them cross split points. After each run the map is compared key by key
+// with an interval_map which the assignments of all threads have been replayed to. Returns false if they differ.
+bool benchmark_sharded( std::size_t steps_per_thread ) {
+	const int key_count = 1 << 16; // keys are 0 .. key_count-1
+	const int shard_count = 64;
+	const unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::vector<int> split_points;
+	for(int i = 1; i < shard_count; i++) {
+		split_points.push_back(i * (key_count / shard_count));
+	}
+
+	for(unsigned threads = 1; threads <= max_threads; threads++) {
+		// Generate the assignments up front, so that the measured time covers nothing but the assign calls.
+		std::vector<std::vector<interval<int,int>>> assignments(threads);
+		std::default_random_engine gen(threads);
+		int region = key_count / threads;
+		for(unsigned t = 0; t < threads; t++) {
+			std::uniform_int_distribution<> dis_begin(t * region, (t + 1) * region - 1);
+			std::uniform_int_distribution<> dis_length(1, 2 * key_count / shard_count);
+			for(std::size_t i = 0; i < steps_per_thread; i++) {
+				int begin = dis_begin(gen);
+				int end = std::min(begin + dis_length(gen), static_cast<int>((t + 1) * region));
+				assignments[t].push_back(interval<int,int>{begin, end, static_cast<int>(i % 5)});
+			}
+		}
+
+		sharded_interval_map<int,int> im(-1, split_points);
+		double ns = elapsed_ns([&]() {
+			std::vector<std::thread> workers;
+			for(unsigned t = 0; t < threads; t++) {
+				workers.push_back(std::thread([&im, &assignments, t]() {
+					for(const auto& item : assignments[t]) {
+						im.assign(item.begin, item.end, item.value);
+					}
+				}));
+			}
+			for(auto& worker : workers) {
+				worker.join();
+			}
+		});
+		// Throughput over all threads: wall clock time per assign.
+		report("assign", "sharded", "disjoint", threads, threads * steps_per_thread, ns, im.size(), 0);
+
+		interval_map<int,int> im_reference(-1);
+		for(const auto& thread_assignments : assignments) {
+			im_reference.assign_sorted(thread_assignments.begin(), thread_assignments.end());
+		}
+		for(int key = -1; key <= key_count; key++) {
+			if(im[key] != im_reference[key]) {
+				std::cerr << "sharded_interval_map differs from interval_map at key " << key << std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+}
+
+int main( int argc, char* argv[] ) {
+	bool const quick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+	std::size_t const count = quick ? 1 << 12 : 1 << 19;
+
+	std::cout << "benchmark\tbackend\tdistribution\tthreads\toperations\tns_per_op\tboundaries\tpeak_bytes" << std::endl;
+	for(char const* name : { "uniform", "append", "overlap", "dense", "large" }) {
+		distribution d = make_distribution(name, count);
+		benchmark_backend<map_storage>("map", d, true);
+		benchmark_backend<btree_storage<>>("btree", d, false);
+	}
+	bool const ok = benchmark_sharded(quick ? 1000 : 200000);
+
+#if defined(__unix__) || defined(__APPLE__)
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) == 0) {
+		// ru_maxrss is in kilobytes on Linux and in bytes on macOS.
+#if defined(__APPLE__)
+		std::cerr << "peak resident set size: " << usage.ru_maxrss / 1024 << " kB" << std::endl;
+#else
+		std::cerr << "peak resident set size: " << usage.ru_maxrss << " kB" << std::endl;
+#endif
+	}
+#endif
+	return ok ? 0 : 1;
+}